@@ -0,0 +1,76 @@
+// Bounded queue for PNG Image Viewer
+// FIFO handoff between pipeline stages: producers block while it is full, so a fast
+// stage cannot run arbitrarily far ahead of a slow one. Records its occupancy.
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cstddef>
+
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : m_capacity(std::max<size_t>(1, capacity)) {}
+
+    // Blocks while full; returns false (item not taken) once the queue is closed
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [&]() { return m_items.size() < m_capacity || m_closed; });
+        if (m_closed) return false;
+        m_items.push_back(std::move(item));
+        m_pushes++;
+        m_occupancySum += m_items.size();
+        m_maxOccupancy = std::max(m_maxOccupancy, m_items.size());
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    // Blocks while empty; returns false once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [&]() { return !m_items.empty() || m_closed; });
+        if (m_items.empty()) return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    // No more pushes; consumers drain what is left
+    void close() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notFull.notify_all();
+        m_notEmpty.notify_all();
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+    // Items queued right after each push, averaged, and the peak
+    double meanOccupancy() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pushes > 0 ? (double)m_occupancySum / m_pushes : 0.0;
+    }
+    size_t maxOccupancy() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_maxOccupancy;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notFull;
+    std::condition_variable m_notEmpty;
+    std::deque<T> m_items;
+    size_t m_capacity;
+    bool m_closed = false;
+
+    size_t m_pushes = 0;
+    size_t m_occupancySum = 0;
+    size_t m_maxOccupancy = 0;
+};
+
+#endif // BOUNDED_QUEUE_H
@@ -0,0 +1,203 @@
+// Colour lookup implementation
+
+#include "color_lut.h"
+#include "file_io.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Sixth-degree polynomial fits of matplotlib's viridis and inferno (per channel,
+// lowest power first), accurate to about one 8-bit step
+static const double kViridis[3][7] = {
+    {0.2777273272234177, 0.1050930431085774, -0.3308618287255563, -4.634230498983486,
+     6.228269936347081, 4.776384997670288, -5.435455855934631},
+    {0.005407344544966578, 1.404613529898575, 0.214847559468213, -5.799100973351585,
+     14.17993336680509, -13.74514537774601, 4.645852612178535},
+    {0.3340998053353061, 1.384590162594685, 0.09509516302823659, -19.33244095627987,
+     56.69055260068105, -65.35303263337234, 26.3124352495832},
+};
+static const double kInferno[3][7] = {
+    {0.0002189403691192265, 0.1065134194856116, 11.60249308247187, -41.70399613139459,
+     77.162935699427, -71.31942824499214, 25.13112622477341},
+    {0.001651004631001012, 0.5639564367884091, -3.972853965665698, 17.43639888205313,
+     -33.40235894210092, 32.62606426397723, -12.24266895238567},
+    {-0.01948089843709184, 3.932712388889277, -15.9423941062914, 44.35414519872813,
+     -81.80730925738993, 73.20951985803202, -23.07032500287172},
+};
+
+// Blue-white-red diverging map (after Moreland's cool-warm), evenly spaced colours
+static const unsigned char kDiverging[][3] = {
+    {59, 76, 192}, {98, 130, 234}, {141, 176, 254}, {184, 208, 249}, {221, 221, 221},
+    {245, 196, 173}, {244, 154, 123}, {222, 96, 77}, {180, 4, 38},
+};
+
+static unsigned char ToByte(double value) {
+    return (unsigned char)std::lround(std::min(255.0, std::max(0.0, value)));
+}
+
+static Colormap PolynomialMap(const char* name, const double coefficients[3][7]) {
+    Colormap map;
+    map.name = name;
+    for (int i = 0; i < 256; ++i) {
+        double t = i / 255.0;
+        for (int c = 0; c < 3; ++c) {
+            double value = 0.0;
+            for (int k = 6; k >= 0; --k) {
+                value = value * t + coefficients[c][k];
+            }
+            map.rgb[i][c] = ToByte(value * 255.0);
+        }
+    }
+    return map;
+}
+
+// Linear interpolation of `count` evenly spaced colours (values 0-255) to 256
+static void Resample(const std::vector<double>& colours, size_t count, Colormap& map) {
+    for (int i = 0; i < 256; ++i) {
+        double position = (count > 1) ? i * (count - 1) / 255.0 : 0.0;
+        size_t lower = std::min((size_t)position, count - 1);
+        size_t upper = std::min(lower + 1, count - 1);
+        double frac = position - lower;
+        for (int c = 0; c < 3; ++c) {
+            map.rgb[i][c] = ToByte(colours[lower * 3 + c] * (1.0 - frac) + colours[upper * 3 + c] * frac);
+        }
+    }
+}
+
+const std::vector<Colormap>& BuiltinColormaps() {
+    static const std::vector<Colormap> maps = []() {
+        std::vector<Colormap> result;
+
+        Colormap gray;
+        gray.name = "gray";
+        for (int i = 0; i < 256; ++i) {
+            gray.rgb[i][0] = gray.rgb[i][1] = gray.rgb[i][2] = (unsigned char)i;
+        }
+        result.push_back(gray);
+        result.push_back(PolynomialMap("viridis", kViridis));
+        result.push_back(PolynomialMap("inferno", kInferno));
+
+        Colormap diverging;
+        diverging.name = "diverging";
+        size_t count = sizeof(kDiverging) / sizeof(kDiverging[0]);
+        std::vector<double> colours;
+        for (size_t i = 0; i < count; ++i) {
+            colours.insert(colours.end(), kDiverging[i], kDiverging[i] + 3);
+        }
+        Resample(colours, count, diverging);
+        result.push_back(diverging);
+        return result;
+    }();
+    return maps;
+}
+
+bool LoadColormapFile(const std::string& path, Colormap& map) {
+    std::vector<unsigned char> contents;
+    if (!ReadFileContents(path, contents)) {
+        return false;
+    }
+
+    size_t slash = path.find_last_of('/');
+    map.name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+
+    // Binary ImageJ layout: planar reds, greens, blues
+    bool text = std::all_of(contents.begin(), contents.end(), [](unsigned char c) {
+        return c == '\n' || c == '\r' || c == '\t' || (c >= 32 && c < 127);
+    });
+    if (!text && contents.size() == 768) {
+        for (int i = 0; i < 256; ++i) {
+            map.rgb[i][0] = contents[i];
+            map.rgb[i][1] = contents[256 + i];
+            map.rgb[i][2] = contents[512 + i];
+        }
+        return true;
+    }
+
+    // Text: the first three numbers of every line that has them
+    std::vector<double> colours;
+    std::istringstream input(std::string(contents.begin(), contents.end()));
+    std::string line;
+    while (std::getline(input, line)) {
+        line = line.substr(0, line.find('#'));
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream fields(line);
+        double r, g, b;
+        if (fields >> r >> g >> b) {
+            colours.insert(colours.end(), {r, g, b});
+        }
+    }
+    size_t count = colours.size() / 3;
+    if (count < 2) {
+        std::cerr << "Colormap " << path << ": expected a 768-byte binary table or at least two \"r g b\" lines" << std::endl;
+        return false;
+    }
+    if (*std::max_element(colours.begin(), colours.end()) <= 1.0) {
+        for (double& value : colours) value *= 255.0;
+    }
+    Resample(colours, count, map);
+    return true;
+}
+
+void ColorLut::build(PixelFormat format, const Colormap* map, double low, double high) {
+    m_format = format;
+    m_table.clear();
+    if (format == PixelFormat::RGB8) return;
+
+    // Samples at or below `low` get the first colour, at or above `high` the last;
+    // positions in between are interpolated between neighbouring colours
+    const Colormap& colours = map ? *map : BuiltinColormaps()[0];
+    size_t entries = (format == PixelFormat::Gray16) ? 65536 : 256;
+    double scale = 255.0 / ((entries - 1) * std::max(high - low, 1e-9));
+    double offset = low * (entries - 1);
+    m_table.resize(entries);
+    for (size_t v = 0; v < entries; ++v) {
+        double position = std::clamp((v - offset) * scale, 0.0, 255.0);
+        int lower = std::min((int)position, 254);
+        double frac = position - lower;
+        const unsigned char* a = colours.rgb[lower];
+        const unsigned char* b = colours.rgb[lower + 1];
+        m_table[v] = (uint32_t)ToByte(a[0] + (b[0] - a[0]) * frac)
+                   | (uint32_t)ToByte(a[1] + (b[1] - a[1]) * frac) << 8
+                   | (uint32_t)ToByte(a[2] + (b[2] - a[2]) * frac) << 16;
+    }
+}
+
+// Each colour is stored as one 4-byte write (little-endian R, G, B and a byte the
+// next pixel overwrites); the last pixel is written byte by byte to stay in bounds
+template <typename Sample>
+static void ApplyTable(const uint32_t* table, const Sample* src, size_t pixels, unsigned char* rgb) {
+    if (pixels == 0) return;
+    size_t i = 0;
+    for (; i + 1 < pixels; ++i, rgb += 3) {
+        uint32_t p = table[src[i]];
+        memcpy(rgb, &p, 4);
+    }
+    uint32_t p = table[src[i]];
+    rgb[0] = (unsigned char)p;
+    rgb[1] = (unsigned char)(p >> 8);
+    rgb[2] = (unsigned char)(p >> 16);
+}
+
+void ColorLut::apply(const unsigned char* src, size_t pixels, unsigned char* rgb) const {
+    switch (m_format) {
+        case PixelFormat::Gray8:
+            ApplyTable(m_table.data(), src, pixels, rgb);
+            break;
+        case PixelFormat::Gray16:
+            ApplyTable(m_table.data(), (const uint16_t*)src, pixels, rgb);
+            break;
+        default:
+            memcpy(rgb, src, pixels * 3);
+            break;
+    }
+}
+
+const unsigned char* ColorLut::toRGB(const unsigned char* src, size_t pixels,
+                                     std::vector<unsigned char>& buffer) const {
+    if (m_format == PixelFormat::RGB8) return src;
+    buffer.resize(pixels * 3);
+    apply(src, pixels, buffer.data());
+    return buffer.data();
+}
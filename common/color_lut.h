@@ -0,0 +1,53 @@
+// Colour lookup for PNG Image Viewer
+// Previews are stored in their native PixelFormat; single-channel frames are turned
+// into RGB8 through a lookup table only when they are drawn or exported, so switching
+// the colormap only rebuilds the table and never re-decodes a frame
+
+#ifndef COLOR_LUT_H
+#define COLOR_LUT_H
+
+#include "frame_types.h"
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// A colormap: 256 RGB colours from the lowest to the highest sample value
+struct Colormap {
+    std::string name;
+    unsigned char rgb[256][3];
+};
+
+// Built-in colormaps: gray, viridis, inferno and diverging (blue-white-red)
+const std::vector<Colormap>& BuiltinColormaps();
+
+// Load a custom colormap: either a 768-byte binary table (256 reds, 256 greens,
+// 256 blues, as ImageJ .lut files) or text with one "r g b" colour per line
+// (0-255, or 0-1 if no value is above 1; '#' starts a comment), resampled to 256
+// colours. Returns false with a message on cerr if the file is unusable.
+bool LoadColormapFile(const std::string& path, Colormap& map);
+
+class ColorLut {
+public:
+    // Build the table for `format` and `map` (gray ramp if none): 256 entries for
+    // Gray8 and 65536 for Gray16, interpolated between the map's colours. The levels
+    // window [low, high] (fractions of the sample range) is stretched over the whole
+    // map. RGB8 needs none.
+    void build(PixelFormat format, const Colormap* map = nullptr, double low = 0.0, double high = 1.0);
+    PixelFormat format() const { return m_format; }
+
+    // Convert `pixels` samples in the table's format to RGB8 (RGB8 input is copied)
+    void apply(const unsigned char* src, size_t pixels, unsigned char* rgb) const;
+
+    // RGB8 version of src: src itself for RGB8, otherwise converted into buffer
+    const unsigned char* toRGB(const unsigned char* src, size_t pixels, std::vector<unsigned char>& buffer) const;
+
+    // Colour of one sample value (packed R | G << 8 | B << 16)
+    uint32_t lookup(unsigned value) const { return m_table[value]; }
+
+private:
+    PixelFormat m_format = PixelFormat::RGB8;
+    std::vector<uint32_t> m_table;          // One packed colour per sample value
+};
+
+#endif // COLOR_LUT_H
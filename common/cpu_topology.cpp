@@ -0,0 +1,156 @@
+// CPU topology implementation
+
+#include "cpu_topology.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <thread>
+#include <tuple>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+bool g_pinning = false;
+std::vector<int> g_slotCPUs;        // CPU of each pinning slot
+
+// CPU list like "0-3,8,10-11" (sysfs format)
+std::vector<int> ParseCpuList(const std::string& text) {
+    std::vector<int> cpus;
+    const char* p = text.c_str();
+    while (*p) {
+        int first = 0, last = 0, used = 0;
+        if (sscanf(p, "%d%n", &first, &used) != 1) break;
+        p += used;
+        last = first;
+        if (*p == '-' && sscanf(p + 1, "%d%n", &last, &used) == 1) {
+            p += 1 + used;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        if (*p != ',') break;
+        p++;
+    }
+    return cpus;
+}
+
+std::string ReadLine(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+std::vector<int> AffinityCPUs() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        int count = std::max(1u, std::thread::hardware_concurrency());
+        for (int cpu = 0; cpu < count; ++cpu) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+// CPU quota of this process's cgroup in CPUs, 0 if unlimited or unknown
+double CgroupQuota() {
+    // cgroup v2: "<quota> <period>" or "max <period>" in the group's cpu.max
+    std::string group = ReadLine("/proc/self/cgroup");
+    std::vector<std::string> candidates;
+    if (group.compare(0, 3, "0::") == 0) {
+        candidates.push_back("/sys/fs/cgroup" + group.substr(3) + "/cpu.max");
+    }
+    candidates.push_back("/sys/fs/cgroup/cpu.max");
+    for (const std::string& path : candidates) {
+        std::string line = ReadLine(path);
+        double quota = 0.0, period = 0.0;
+        if (sscanf(line.c_str(), "%lf %lf", &quota, &period) == 2 && quota > 0 && period > 0) {
+            return quota / period;
+        }
+        if (!line.empty()) return 0.0;      // "max"
+    }
+
+    // cgroup v1: cfs quota of -1 means unlimited
+    double quota = atof(ReadLine("/sys/fs/cgroup/cpu/cpu.cfs_quota_us").c_str());
+    double period = atof(ReadLine("/sys/fs/cgroup/cpu/cpu.cfs_period_us").c_str());
+    return (quota > 0 && period > 0) ? quota / period : 0.0;
+}
+
+}  // namespace
+
+CpuBudget DetectCpuBudget() {
+    CpuBudget budget;
+    budget.affinityCPUs = (int)AffinityCPUs().size();
+    budget.quotaCPUs = CgroupQuota();
+    budget.available = budget.affinityCPUs;
+    if (budget.quotaCPUs > 0) {
+        budget.available = std::min(budget.available, (int)std::ceil(budget.quotaCPUs));
+    }
+    budget.available = std::max(1, budget.available);
+    return budget;
+}
+
+std::string ConfigureThreadPinning(bool enabled) {
+    g_pinning = false;
+    g_slotCPUs.clear();
+    if (!enabled) return "off";
+#ifndef __linux__
+    return "not supported on this platform";
+#else
+    // Sort key: SMT sibling rank, position of the core in its socket, socket
+    struct Slot {
+        int rank, position, package, cpu;
+    };
+    std::vector<Slot> slots;
+    std::vector<int> packageCores;
+    for (int cpu : AffinityCPUs()) {
+        std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        std::vector<int> siblings = ParseCpuList(ReadLine(topology + "thread_siblings_list"));
+        int rank = (int)(std::find(siblings.begin(), siblings.end(), cpu) - siblings.begin());
+        if (rank == (int)siblings.size()) rank = 0;
+        int package = std::max(0, atoi(ReadLine(topology + "physical_package_id").c_str()));
+        if ((int)packageCores.size() <= package) packageCores.resize(package + 1, 0);
+        slots.push_back({rank, 0, package, cpu});
+    }
+    std::sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) {
+        return std::tie(a.rank, a.package, a.cpu) < std::tie(b.rank, b.package, b.cpu);
+    });
+    for (Slot& slot : slots) {
+        slot.position = slot.rank == 0 ? packageCores[slot.package]++ : 0;
+    }
+    std::stable_sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) {
+        return std::tie(a.rank, a.position, a.package) < std::tie(b.rank, b.position, b.package);
+    });
+    for (const Slot& slot : slots) {
+        g_slotCPUs.push_back(slot.cpu);
+    }
+    g_pinning = !g_slotCPUs.empty();
+
+    size_t cores = std::count_if(slots.begin(), slots.end(), [](const Slot& s) { return s.rank == 0; });
+    return "on (" + std::to_string(g_slotCPUs.size()) + " CPUs, " + std::to_string(cores) + " cores, "
+           + std::to_string(packageCores.size()) + " sockets)";
+#endif
+}
+
+void PinThisThread(int slot) {
+#ifdef __linux__
+    if (!g_pinning || slot < 0) return;
+    int cpu = g_slotCPUs[(size_t)slot % g_slotCPUs.size()];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)slot;
+#endif
+}
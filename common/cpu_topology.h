@@ -0,0 +1,28 @@
+// CPU topology for PNG Image Viewer
+// How many CPUs this process may really use (affinity mask and cgroup CPU quota,
+// not the machine's core count), and optional pinning of worker threads to them
+
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <string>
+
+// CPUs available to this process
+struct CpuBudget {
+    int affinityCPUs = 1;       // CPUs in the affinity mask (e.g. taskset, Slurm allocation)
+    double quotaCPUs = 0.0;     // cgroup CPU quota in CPUs (0 = none)
+    int available = 1;          // Affinity mask limited by the quota (rounded up), at least 1
+};
+
+CpuBudget DetectCpuBudget();
+
+// Enable pinning for threads started from now on. The allowed CPUs are ordered so
+// that consecutive slots land on distinct physical cores, alternating between
+// sockets, before SMT siblings are used. Returns a one-line description.
+std::string ConfigureThreadPinning(bool enabled);
+
+// Pin the calling thread to the CPU of `slot` (wrapping around). No-op unless
+// pinning is enabled.
+void PinThisThread(int slot);
+
+#endif // CPU_TOPOLOGY_H
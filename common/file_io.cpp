@@ -0,0 +1,131 @@
+// File input implementation
+
+#include "file_io.h"
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+static const size_t kMaxReadRequest = 8u << 20;
+
+#ifndef _WIN32
+
+bool ReadFileContents(const std::string& path, std::vector<unsigned char>& contents) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Could not open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "Could not stat " << path << ": " << strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t size = (size_t)st.st_size;
+    contents.resize(size);
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, contents.data() + done, std::min(size - done, kMaxReadRequest));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    close(fd);
+
+    if (done != size) {
+        std::cerr << "Short read on " << path << " (" << done << " of " << size << " bytes)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void HintFileRead(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
+
+#else
+
+bool ReadFileContents(const std::string& path, std::vector<unsigned char>& contents) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Could not open " << path << std::endl;
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    contents.resize(size > 0 ? (size_t)size : 0);
+    bool ok = size >= 0 && std::fread(contents.data(), 1, contents.size(), file) == contents.size();
+    std::fclose(file);
+    return ok;
+}
+
+void HintFileRead(const std::string&) {}
+
+#endif
+
+void ReadAhead::start(std::vector<std::string> files, int ioThreads, size_t window) {
+    stop();
+    if (ioThreads <= 0 || files.empty()) return;
+
+    m_files = std::move(files);
+    m_window = std::max<size_t>(1, window);
+    m_next = 0;
+    m_consumed = 0;
+    m_stopping = false;
+
+    int threads = std::min(ioThreads, (int)m_files.size());
+    for (int t = 0; t < threads; ++t) {
+        m_threads.emplace_back(&ReadAhead::ioLoop, this);
+    }
+}
+
+void ReadAhead::consumed() {
+    if (m_threads.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_consumed++;
+    }
+    m_progress.notify_all();
+}
+
+void ReadAhead::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_progress.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+    m_files.clear();
+}
+
+void ReadAhead::ioLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopping && m_next < m_files.size()) {
+        // Stay within the window so hinted data is still cached when it is decoded
+        if (m_next >= m_consumed + m_window) {
+            m_progress.wait(lock);
+            continue;
+        }
+        size_t i = m_next++;
+        lock.unlock();
+        HintFileRead(m_files[i]);
+        lock.lock();
+    }
+}
@@ -0,0 +1,53 @@
+// File input for PNG Image Viewer
+// Whole-file reads with large requests, and read-ahead hints issued by separate I/O
+// threads so the file system sees a deep queue regardless of the decode thread count
+
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// Read a whole file into contents with a few large reads (sized from the file,
+// at most 8 MB each) instead of stdio's small buffered ones.
+// Returns false (and prints the reason) if the file cannot be read.
+bool ReadFileContents(const std::string& path, std::vector<unsigned char>& contents);
+
+// Ask the OS to start fetching a file into the page cache (posix_fadvise WILLNEED);
+// returns without waiting for the data
+void HintFileRead(const std::string& path);
+
+// Read-ahead for a consumer that reads files in (roughly) list order: I/O threads
+// hint the files up to `window` entries ahead of the ones consumed so far
+class ReadAhead {
+public:
+    ReadAhead() = default;
+    ~ReadAhead() { stop(); }
+
+    ReadAhead(const ReadAhead&) = delete;
+    ReadAhead& operator=(const ReadAhead&) = delete;
+
+    // No threads are started for ioThreads <= 0
+    void start(std::vector<std::string> files, int ioThreads, size_t window);
+    void consumed();                            // The consumer took one more file
+    void stop();
+
+private:
+    void ioLoop();
+
+    std::vector<std::string> m_files;
+    size_t m_window = 0;
+    size_t m_next = 0;                          // Next file to hint
+    size_t m_consumed = 0;
+    bool m_stopping = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_progress;
+    std::vector<std::thread> m_threads;
+};
+
+#endif // FILE_IO_H
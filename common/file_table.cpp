@@ -0,0 +1,100 @@
+// File table implementation
+
+#include "file_table.h"
+#include <algorithm>
+
+int64_t ParseFrameIndex(const char* name, size_t length) {
+    // Last '.', then the last '_' before it
+    size_t dotPos = length;
+    while (dotPos > 0 && name[dotPos - 1] != '.') dotPos--;
+    if (dotPos == 0) return -1;
+    dotPos--;
+
+    size_t underscore = dotPos;
+    while (underscore > 0 && name[underscore - 1] != '_') underscore--;
+    if (underscore == 0) return -1;
+
+    size_t digits = dotPos - underscore;
+    if (digits == 0 || digits > 18) return -1;
+
+    int64_t value = 0;
+    for (size_t i = underscore; i < dotPos; ++i) {
+        unsigned digit = (unsigned char)name[i] - '0';
+        if (digit > 9) return -1;
+        value = value * 10 + digit;
+    }
+    return value;
+}
+
+bool FileTable::add(const char* name, size_t length) {
+    int64_t index = ParseFrameIndex(name, length);
+    if (index < 0) return false;
+
+    m_entries.push_back({index, (uint32_t)m_pool.size(), (uint32_t)length});
+    m_pool.append(name, length);
+    return true;
+}
+
+void FileTable::sortByIndex() {
+    size_t count = m_entries.size();
+    if (count < 2) return;
+
+    // One counting pass per byte of the index; bytes that are equal in every
+    // entry (typically the high ones) are skipped
+    std::vector<Entry> buffer(count);
+    Entry* src = m_entries.data();
+    Entry* dst = buffer.data();
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t histogram[256] = {};
+        for (size_t i = 0; i < count; ++i) {
+            histogram[(uint64_t)src[i].index >> shift & 0xFF]++;
+        }
+        if (histogram[(uint64_t)src[0].index >> shift & 0xFF] == count) continue;
+
+        size_t offset = 0;
+        for (size_t& bucket : histogram) {
+            size_t n = bucket;
+            bucket = offset;
+            offset += n;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            dst[histogram[(uint64_t)src[i].index >> shift & 0xFF]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+
+    if (src != m_entries.data()) {
+        std::copy(src, src + count, m_entries.data());
+    }
+}
+
+std::string FileTable::path(size_t i) const {
+    std::string result;
+    result.reserve(m_folder.size() + 1 + m_entries[i].length);
+    result.append(m_folder).append(1, '/').append(m_pool, m_entries[i].offset, m_entries[i].length);
+    return result;
+}
+
+std::vector<std::string> FileTable::previewPaths(int nthFrame) const {
+    size_t step = std::max(1, nthFrame);
+    std::vector<std::string> paths;
+    paths.reserve(previewCount(nthFrame));
+    for (size_t i = 0; i < size(); i += step) {
+        paths.push_back(path(i));
+    }
+    // Always include last frame
+    if (!empty() && (size() - 1) % step != 0) {
+        paths.push_back(path(size() - 1));
+    }
+    return paths;
+}
+
+size_t FileTable::previewCount(int nthFrame) const {
+    size_t step = std::max(1, nthFrame);
+    size_t count = (size() + step - 1) / step;
+    if (!empty() && (size() - 1) % step != 0) {
+        count++;
+    }
+    return count;
+}
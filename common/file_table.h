@@ -0,0 +1,51 @@
+// File table for PNG Image Viewer
+// Compact list of the frame files of one folder, sorted by their numeric index:
+// names live back to back in one string pool, paths are built on demand
+
+#ifndef FILE_TABLE_H
+#define FILE_TABLE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Numeric index of a name like "e_png_yx_0.5_000100.png" (the digits between the
+// last '_' and the extension), or -1 if the name does not match *_<number>.<ext>.
+// No allocation; indices up to 18 digits are supported.
+int64_t ParseFrameIndex(const char* name, size_t length);
+
+class FileTable {
+public:
+    FileTable() = default;
+    explicit FileTable(std::string folder) : m_folder(std::move(folder)) {}
+
+    // Add a file name (without folder); returns false if it has no frame index
+    bool add(const char* name, size_t length);
+    void sortByIndex();                         // Stable LSD radix sort on the 64-bit index
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+    const std::string& folder() const { return m_folder; }
+
+    int64_t index(size_t i) const { return m_entries[i].index; }
+    std::string name(size_t i) const { return m_pool.substr(m_entries[i].offset, m_entries[i].length); }
+    std::string path(size_t i) const;           // folder + "/" + name
+
+    // Every n-th path plus the last one (the preview selection)
+    std::vector<std::string> previewPaths(int nthFrame) const;
+    size_t previewCount(int nthFrame) const;
+
+private:
+    struct Entry {
+        int64_t index;
+        uint32_t offset;                        // Into m_pool
+        uint32_t length;
+    };
+
+    std::string m_folder;
+    std::string m_pool;
+    std::vector<Entry> m_entries;
+};
+
+#endif // FILE_TABLE_H
@@ -0,0 +1,253 @@
+// Preview frame memory implementation
+
+#include "frame_memory.h"
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <vector>
+#include <atomic>
+#include <iostream>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Stored at the start of every allocation; the pixels follow kHeaderBytes later,
+// so mapped buffers keep their pixels cache line aligned
+struct BufferHeader {
+    void* base;             // Start of the allocation or mapping
+    size_t mappedBytes;     // 0 = heap allocation
+};
+const size_t kHeaderBytes = 64;
+
+const size_t kMinMappedBytes = 1 << 20;
+const size_t kPageBytes = 4096;
+const size_t kHugePageBytes = 2 << 20;
+
+size_t RoundUp(size_t bytes, size_t unit) {
+    return (bytes + unit - 1) & ~(unit - 1);
+}
+
+HugePageMode g_hugePages = HugePageMode::Off;
+NumaPlacement g_placement = NumaPlacement::Off;
+std::vector<unsigned long> g_nodeMask;      // mbind node mask for g_placement
+std::atomic<bool> g_hugeTlbFailed(false);
+
+// Every mapped buffer is one kernel mapping, and a process only gets
+// vm.max_map_count of them (65530 by default) for everything it maps: thread
+// stacks, libraries and large heap blocks too. Mapped buffers stop at 3/4 of the
+// limit and further ones come from the heap.
+std::atomic<size_t> g_liveMappings(0);
+size_t g_mappingLimit = SIZE_MAX;
+std::atomic<bool> g_mappingFallbackReported(false);
+
+void ReportMappingFallback(const std::string& reason) {
+    if (!g_mappingFallbackReported.exchange(true)) {
+        std::cerr << "Frame memory: " << reason << ", previews that cannot be mapped come from "
+                  << "the heap without huge pages or NUMA placement" << std::endl;
+    }
+}
+
+// Whether a buffer of `total` bytes (header included) is mapped rather than taken
+// from the heap, and whether it comes from the MAP_HUGETLB pool. HugeTLB mappings are
+// whole huge pages, so they are only used where rounding up wastes at most 1/8.
+bool UseMapping(size_t total) {
+#ifdef __linux__
+    return total >= kMinMappedBytes && (g_hugePages != HugePageMode::Off || g_placement != NumaPlacement::Off);
+#else
+    (void)total;
+    return false;
+#endif
+}
+
+bool UseHugeTlb(size_t total) {
+    return g_hugePages == HugePageMode::HugeTLB && RoundUp(total, kHugePageBytes) - total <= total / 8;
+}
+
+#ifdef __linux__
+// Memory policy modes of mbind(2), without depending on libnuma's headers
+const int kMpolPreferred = 1;
+const int kMpolInterleave = 3;
+
+// Online NUMA nodes from sysfs ("0-1,3"); empty if unknown
+std::vector<int> OnlineNodes() {
+    std::vector<int> nodes;
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (!file) return nodes;
+    int first, last;
+    while (fscanf(file, "%d", &first) == 1) {
+        last = first;
+        int c = fgetc(file);
+        if (c == '-') {
+            if (fscanf(file, "%d", &last) != 1) break;
+            c = fgetc(file);
+        }
+        for (int node = first; node <= last; ++node) nodes.push_back(node);
+        if (c != ',') break;
+    }
+    fclose(file);
+    return nodes;
+}
+
+// vm.max_map_count; 0 if unknown
+size_t MaxMapCount() {
+    size_t count = 0;
+    FILE* file = fopen("/proc/sys/vm/max_map_count", "r");
+    if (!file) return 0;
+    if (fscanf(file, "%zu", &count) != 1) count = 0;
+    fclose(file);
+    return count;
+}
+
+void SetNode(std::vector<unsigned long>& mask, int node) {
+    const int bits = 8 * sizeof(unsigned long);
+    if ((int)mask.size() <= node / bits) mask.resize(node / bits + 1, 0);
+    mask[node / bits] |= 1UL << (node % bits);
+}
+
+// Anonymous mapping of `bytes` rounded to pages, starting 2 MB aligned so THP can back
+// every whole 2 MB extent (the tail uses small pages); nullptr on failure
+void* MapAligned(size_t bytes, size_t& mappedBytes) {
+    size_t size = RoundUp(bytes, kPageBytes);
+    size_t span = size + kHugePageBytes;
+    void* raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return nullptr;
+
+    // Trim the unaligned head and the tail
+    uintptr_t start = (uintptr_t)raw;
+    uintptr_t aligned = (start + kHugePageBytes - 1) & ~(uintptr_t)(kHugePageBytes - 1);
+    if (aligned > start) munmap(raw, aligned - start);
+    size_t tail = (start + span) - (aligned + size);
+    if (tail > 0) munmap((void*)(aligned + size), tail);
+    mappedBytes = size;
+    return (void*)aligned;
+}
+
+void* MapFrameMemory(size_t bytes, size_t& mappedBytes) {
+    void* base = nullptr;
+    if (UseHugeTlb(bytes) && !g_hugeTlbFailed.load(std::memory_order_relaxed)) {
+        size_t size = RoundUp(bytes, kHugePageBytes);
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base == MAP_FAILED) {
+            base = nullptr;
+            if (!g_hugeTlbFailed.exchange(true)) {
+                std::cerr << "MAP_HUGETLB failed (no huge pages reserved in /proc/sys/vm/nr_hugepages?), "
+                          << "using transparent huge pages" << std::endl;
+            }
+        } else {
+            mappedBytes = size;
+        }
+    }
+    if (!base && g_hugePages == HugePageMode::Off) {
+        // NUMA placement only: plain pages, no alignment needed
+        mappedBytes = RoundUp(bytes, kPageBytes);
+        base = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) return nullptr;
+    } else if (!base) {
+        base = MapAligned(bytes, mappedBytes);
+        if (!base) return nullptr;
+        madvise(base, mappedBytes, MADV_HUGEPAGE);
+    }
+
+    // Policy is applied before the first touch, so it decides where the pages land
+    if (!g_nodeMask.empty()) {
+        int mode = (g_placement == NumaPlacement::Interleave) ? kMpolInterleave : kMpolPreferred;
+        syscall(SYS_mbind, base, mappedBytes, mode, g_nodeMask.data(),
+                (unsigned long)(g_nodeMask.size() * 8 * sizeof(unsigned long) + 1), 0u);
+    }
+    return base;
+}
+#endif
+
+}  // namespace
+
+std::string ConfigureFrameMemory(HugePageMode hugePages, NumaPlacement placement) {
+    g_hugePages = hugePages;
+    g_placement = placement;
+    g_nodeMask.clear();
+#ifdef __linux__
+    size_t maxMapCount = MaxMapCount();
+    g_mappingLimit = maxMapCount > 0 ? maxMapCount - maxMapCount / 4 : SIZE_MAX;
+#endif
+    std::string description = std::string("huge pages ") + HugePageModeName(hugePages);
+
+#ifdef __linux__
+    if (placement != NumaPlacement::Off) {
+        std::vector<int> nodes = OnlineNodes();
+        if (nodes.size() < 2) {
+            g_placement = NumaPlacement::Off;
+            return description + ", NUMA " + NumaPlacementName(placement) + " ignored (single node)";
+        }
+        if (placement == NumaPlacement::Interleave) {
+            for (int node : nodes) SetNode(g_nodeMask, node);
+            return description + ", NUMA interleave over " + std::to_string(nodes.size()) + " nodes";
+        }
+        unsigned cpu = 0, node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+            g_placement = NumaPlacement::Off;
+            return description + ", NUMA display ignored (node unknown)";
+        }
+        SetNode(g_nodeMask, (int)node);
+        return description + ", NUMA node " + std::to_string(node) + " (display thread)";
+    }
+#else
+    g_hugePages = HugePageMode::Off;
+    g_placement = NumaPlacement::Off;
+    if (hugePages != HugePageMode::Off || placement != NumaPlacement::Off) {
+        return "huge pages and NUMA placement are not supported on this platform";
+    }
+#endif
+    return description + ", NUMA " + NumaPlacementName(g_placement);
+}
+
+unsigned char* AllocFrameBuffer(size_t bytes) {
+    size_t total = kHeaderBytes + bytes;
+    BufferHeader header = {nullptr, 0};
+#ifdef __linux__
+    if (UseMapping(total)) {
+        if (g_liveMappings.fetch_add(1) >= g_mappingLimit) {
+            g_liveMappings.fetch_sub(1);
+            ReportMappingFallback(std::to_string(g_mappingLimit) + " mapped buffers reach 3/4 of vm.max_map_count");
+        } else {
+            header.base = MapFrameMemory(total, header.mappedBytes);
+            if (!header.base) {
+                g_liveMappings.fetch_sub(1);
+                ReportMappingFallback(std::string("mmap failed (") + strerror(errno) + ")");
+            }
+        }
+    }
+#endif
+    if (!header.base) {
+        header.mappedBytes = 0;
+        header.base = std::malloc(total);
+        if (!header.base) throw std::bad_alloc();
+    }
+    memcpy(header.base, &header, sizeof(header));
+    return (unsigned char*)header.base + kHeaderBytes;
+}
+
+size_t FrameBufferFootprint(size_t bytes) {
+    size_t total = kHeaderBytes + bytes;
+    if (!UseMapping(total)) return total;
+    return RoundUp(total, UseHugeTlb(total) ? kHugePageBytes : kPageBytes);
+}
+
+void FreeFrameBuffer(unsigned char* buffer) {
+    if (!buffer) return;
+    BufferHeader header;
+    memcpy(&header, buffer - kHeaderBytes, sizeof(header));
+#ifdef __linux__
+    if (header.mappedBytes > 0) {
+        munmap(header.base, header.mappedBytes);
+        g_liveMappings.fetch_sub(1);
+        return;
+    }
+#endif
+    std::free(header.base);
+}
@@ -0,0 +1,59 @@
+// Preview frame memory for PNG Image Viewer
+// Preview buffers are allocated here rather than with new[], so that large ones can
+// be backed by huge pages and placed on NUMA nodes chosen for playback instead of
+// on the node of whichever loader thread happened to decode them.
+
+#ifndef FRAME_MEMORY_H
+#define FRAME_MEMORY_H
+
+#include <cstddef>
+#include <string>
+
+// Page size backing large frame buffers
+enum class HugePageMode {
+    Off,            // Regular heap allocation
+    Transparent,    // 2 MB aligned mappings advised MADV_HUGEPAGE (THP)
+    HugeTLB         // MAP_HUGETLB from the reserved pool, THP if the pool is empty
+};
+
+inline const char* HugePageModeName(HugePageMode mode) {
+    switch (mode) {
+        case HugePageMode::Transparent: return "thp";
+        case HugePageMode::HugeTLB:     return "hugetlb";
+        default:                        return "off";
+    }
+}
+
+// NUMA node policy for large frame buffers
+enum class NumaPlacement {
+    Off,            // First touch: the node of the decoding thread
+    Interleave,     // Pages spread round-robin over all nodes
+    Display         // Preferably on the node of the thread that configured it (the display thread)
+};
+
+inline const char* NumaPlacementName(NumaPlacement placement) {
+    switch (placement) {
+        case NumaPlacement::Interleave: return "interleave";
+        case NumaPlacement::Display:    return "display";
+        default:                        return "off";
+    }
+}
+
+// Set the policy for buffers allocated from now on; call from the display thread
+// before loading. Returns a one-line description of what is in effect (e.g. a
+// placement on a single-node machine is reported as ignored).
+std::string ConfigureFrameMemory(HugePageMode hugePages, NumaPlacement placement);
+
+// Buffer for frame pixels (or packed frames); throws std::bad_alloc like new[].
+// Buffers of a megabyte or more are mapped with the configured policy, rounded to
+// 4 KB pages (to 2 MB huge pages for hugetlb, where that adds at most 1/8), smaller
+// ones come from the heap, as do large ones once mapped buffers reach 3/4 of
+// vm.max_map_count (reported once). Free with FreeFrameBuffer (nullptr is ignored).
+unsigned char* AllocFrameBuffer(size_t bytes);
+void FreeFrameBuffer(unsigned char* buffer);
+
+// Memory a buffer of `bytes` takes under the current policy, header and rounding
+// included (heap allocator overhead aside)
+size_t FrameBufferFootprint(size_t bytes);
+
+#endif // FRAME_MEMORY_H
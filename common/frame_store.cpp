@@ -0,0 +1,237 @@
+// Compressed preview frame implementation
+
+#include "frame_store.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+namespace {
+
+// Prefix of every packed frame
+struct PackedHeader {
+    uint64_t id;            // Cache key, unique per packed frame
+    uint32_t rawBytes;      // Unpacked size
+    uint8_t codec;          // FrameCompression used
+    uint8_t delta;          // 1 = bytes are the difference to the keyframe's
+    uint16_t reserved;
+};
+
+std::atomic<uint64_t> g_nextPackedId(1);
+
+// Keeps the bandwidth measurement's reads from being optimized away
+volatile uint64_t g_bandwidthSink = 0;
+
+// Run-length code: a control byte c < 128 is followed by c + 1 literal bytes,
+// c >= 128 by one byte repeated c - 126 times (2 to 129). Returns the coded size,
+// or 0 if it would exceed capacity.
+size_t EncodeRuns(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity) {
+    size_t out = 0;
+    size_t literalStart = 0;
+    auto flushLiterals = [&](size_t end) {
+        while (literalStart < end) {
+            size_t count = std::min<size_t>(end - literalStart, 128);
+            if (out + 1 + count > capacity) return false;
+            dst[out++] = (unsigned char)(count - 1);
+            memcpy(dst + out, src + literalStart, count);
+            out += count;
+            literalStart += count;
+        }
+        return true;
+    };
+
+    size_t i = 0;
+    while (i < size) {
+        unsigned char value = src[i];
+        size_t end = i + 1;
+        size_t limit = std::min(size, i + 129);
+        while (end < limit && src[end] == value) end++;
+        if (end - i >= 3) {
+            if (!flushLiterals(i) || out + 2 > capacity) return 0;
+            dst[out++] = (unsigned char)(126 + (end - i));
+            dst[out++] = value;
+            i = end;
+            literalStart = i;
+        } else {
+            i++;
+        }
+    }
+    return flushLiterals(size) ? out : 0;
+}
+
+bool DecodeRuns(const unsigned char* src, size_t size, unsigned char* dst, size_t dstSize) {
+    const unsigned char* end = src + size;
+    size_t out = 0;
+    while (src < end) {
+        unsigned c = *src++;
+        if (c < 128) {
+            size_t count = c + 1;
+            if (src + count > end || out + count > dstSize) return false;
+            memcpy(dst + out, src, count);
+            src += count;
+            out += count;
+        } else {
+            size_t count = c - 126;
+            if (src >= end || out + count > dstSize) return false;
+            memset(dst + out, *src++, count);
+            out += count;
+        }
+    }
+    return out == dstSize;
+}
+
+}  // namespace
+
+bool FrameCompressionAvailable(FrameCompression mode) {
+#ifdef HAVE_LZ4
+    return true;
+#else
+    return mode != FrameCompression::LZ4;
+#endif
+}
+
+unsigned char* PackFrame(FrameCompression mode, const unsigned char* pixels, size_t bytes,
+                         const unsigned char* keyPixels, uint32_t& packedBytes) {
+    packedBytes = 0;
+    if (mode == FrameCompression::Off || !FrameCompressionAvailable(mode) || bytes == 0 || bytes > UINT32_MAX) {
+        return nullptr;
+    }
+
+    // Byte-wise difference (mod 256) to the keyframe; exact for every pixel format
+    thread_local std::vector<unsigned char> delta;
+    const unsigned char* source = pixels;
+    if (keyPixels) {
+        delta.resize(bytes);
+        for (size_t i = 0; i < bytes; ++i) {
+            delta[i] = (unsigned char)(pixels[i] - keyPixels[i]);
+        }
+        source = delta.data();
+    }
+
+    // Only worth keeping if it saves at least an eighth
+    size_t capacity = bytes - bytes / 8;
+    thread_local std::vector<unsigned char> coded;
+    coded.resize(sizeof(PackedHeader) + capacity);
+    unsigned char* body = coded.data() + sizeof(PackedHeader);
+    size_t codedSize = 0;
+#ifdef HAVE_LZ4
+    if (mode == FrameCompression::LZ4) {
+        codedSize = (size_t)std::max(0, LZ4_compress_default((const char*)source, (char*)body, (int)bytes, (int)capacity));
+    }
+#endif
+    if (mode == FrameCompression::RLE) {
+        codedSize = EncodeRuns(source, bytes, body, capacity);
+    }
+    if (codedSize == 0) {
+        return nullptr;
+    }
+
+    PackedHeader header = {};
+    header.id = g_nextPackedId++;
+    header.rawBytes = (uint32_t)bytes;
+    header.codec = (uint8_t)mode;
+    header.delta = keyPixels ? 1 : 0;
+    memcpy(coded.data(), &header, sizeof(header));
+
+    packedBytes = (uint32_t)(sizeof(PackedHeader) + codedSize);
+    unsigned char* packed = AllocFrameBuffer(packedBytes);
+    memcpy(packed, coded.data(), packedBytes);
+    return packed;
+}
+
+double MeasureFrameReadBandwidth(FrameSpan frames, size_t frameBytes, int passes) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    size_t bytes = 0;
+    for (int pass = 0; pass < passes; ++pass) {
+        for (const ImageFrame& frame : frames) {
+            size_t size = StoredFrameBytes(frame, frameBytes);
+            const unsigned char* data = frame.data;
+            for (size_t i = 0; i + 8 <= size; i += 8) {
+                uint64_t word;
+                memcpy(&word, data + i, 8);
+                sum += word;
+            }
+            bytes += size;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    g_bandwidthSink = sum;
+    return seconds > 0.0 ? bytes / seconds / 1e9 : 0.0;
+}
+
+const unsigned char* FrameCache::pixels(const ImageFrame& frame, size_t frameBytes) {
+    if (frame.packedBytes == 0) return frame.data;
+    if (const unsigned char* cached = lookup(frame.data, frame.packedBytes)) return cached;
+
+    // The keyframe is unpacked (or found) first and so is the most recent entry
+    // when the delta is unpacked; with two or more entries it is not evicted by it
+    const unsigned char* keyPixels = nullptr;
+    if (frame.keyframe) {
+        keyPixels = (frame.keyframeBytes == 0) ? frame.keyframe
+                                               : unpack(frame.keyframe, frame.keyframeBytes, nullptr, frameBytes);
+        if (!keyPixels) return nullptr;
+    }
+    return unpack(frame.data, frame.packedBytes, keyPixels, frameBytes);
+}
+
+const unsigned char* FrameCache::lookup(const unsigned char* packed, uint32_t packedBytes) {
+    PackedHeader header;
+    if (packedBytes < sizeof(header)) return nullptr;
+    memcpy(&header, packed, sizeof(header));
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->id == header.id) {
+            m_entries.splice(m_entries.begin(), m_entries, it);
+            m_hits++;
+            return m_entries.front().pixels.data();
+        }
+    }
+    return nullptr;
+}
+
+const unsigned char* FrameCache::unpack(const unsigned char* packed, uint32_t packedBytes,
+                                        const unsigned char* keyPixels, size_t frameBytes) {
+    if (const unsigned char* cached = lookup(packed, packedBytes)) return cached;
+
+    PackedHeader header;
+    if (packedBytes < sizeof(header)) return nullptr;
+    memcpy(&header, packed, sizeof(header));
+    m_misses++;
+
+    if (header.rawBytes != frameBytes || (header.delta && !keyPixels)) return nullptr;
+
+    // Reuse the least recently used buffer once the cache is full
+    if (m_entries.size() >= std::max<size_t>(m_capacity, 2)) {
+        m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+    } else {
+        m_entries.emplace_front();
+    }
+    Entry& entry = m_entries.front();
+    entry.id = 0;
+    entry.pixels.resize(frameBytes);
+
+    const unsigned char* body = packed + sizeof(header);
+    size_t bodySize = packedBytes - sizeof(header);
+    bool ok = false;
+    if (header.codec == (uint8_t)FrameCompression::RLE) {
+        ok = DecodeRuns(body, bodySize, entry.pixels.data(), frameBytes);
+    }
+#ifdef HAVE_LZ4
+    if (header.codec == (uint8_t)FrameCompression::LZ4) {
+        ok = LZ4_decompress_safe((const char*)body, (char*)entry.pixels.data(), (int)bodySize, (int)frameBytes)
+             == (int)frameBytes;
+    }
+#endif
+    if (!ok) return nullptr;
+
+    if (header.delta) {
+        unsigned char* out = entry.pixels.data();
+        for (size_t i = 0; i < frameBytes; ++i) {
+            out[i] = (unsigned char)(out[i] + keyPixels[i]);
+        }
+    }
+    entry.id = header.id;
+    return entry.pixels.data();
+}
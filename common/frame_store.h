@@ -0,0 +1,71 @@
+// Compressed preview frames for PNG Image Viewer
+// With --compress, previews are kept packed in ImageFrame::data: every keyframe-interval-th
+// frame on its own, the frames in between as a byte-wise delta against that keyframe,
+// each run-length coded (or LZ4 coded when built with LZ4=1). Consecutive simulation
+// frames differ little, so the deltas are mostly zero bytes. Frames are unpacked on
+// demand into a small LRU cache right before they are drawn.
+
+#ifndef FRAME_STORE_H
+#define FRAME_STORE_H
+
+#include "frame_types.h"
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+// Whether a compression mode can be used in this build (LZ4 needs HAVE_LZ4)
+bool FrameCompressionAvailable(FrameCompression mode);
+
+// Pack `bytes` bytes of preview pixels, as a delta against keyPixels (the keyframe's
+// pixels, same size) if given. Returns the packed frame allocated with AllocFrameBuffer
+// and its size, or nullptr if packing would not save at least an eighth (the frame is
+// then stored raw).
+unsigned char* PackFrame(FrameCompression mode, const unsigned char* pixels, size_t bytes,
+                         const unsigned char* keyPixels, uint32_t& packedBytes);
+
+// Bytes a frame occupies in memory
+inline size_t StoredFrameBytes(const ImageFrame& frame, size_t frameBytes) {
+    return frame.packedBytes > 0 ? frame.packedBytes : frameBytes;
+}
+
+// Read every frame's stored bytes `passes` times from the calling thread, as playback
+// does, and return the rate in GB/s (compares huge page and NUMA placements)
+double MeasureFrameReadBandwidth(FrameSpan frames, size_t frameBytes, int passes = 3);
+
+// Unpacked previews of the most recently drawn frames. Not thread-safe: used by the
+// thread that draws.
+class FrameCache {
+public:
+    explicit FrameCache(size_t capacity = 8) : m_capacity(capacity) {}
+
+    // Pixels of frame (frameBytes bytes): frame.data itself for raw frames, otherwise
+    // an unpacked copy that stays valid for the next `capacity` calls at least.
+    // Returns nullptr if the frame cannot be unpacked.
+    const unsigned char* pixels(const ImageFrame& frame, size_t frameBytes);
+
+    // At least this many unpacked frames are kept (e.g. all z-slices of a frame)
+    void reserve(size_t capacity) { m_capacity = std::max(m_capacity, capacity); }
+    void clear() { m_entries.clear(); }
+
+    size_t hits() const { return m_hits; }
+    size_t misses() const { return m_misses; }
+
+private:
+    struct Entry {
+        uint64_t id = 0;                    // Of the packed frame (unique per PackFrame call)
+        std::vector<unsigned char> pixels;
+    };
+
+    const unsigned char* lookup(const unsigned char* packed, uint32_t packedBytes);
+    const unsigned char* unpack(const unsigned char* packed, uint32_t packedBytes,
+                                const unsigned char* keyPixels, size_t frameBytes);
+
+    size_t m_capacity;
+    std::list<Entry> m_entries;             // Most recently used first
+    size_t m_hits = 0;
+    size_t m_misses = 0;
+};
+
+#endif // FRAME_STORE_H
@@ -4,29 +4,181 @@
 #ifndef FRAME_TYPES_H
 #define FRAME_TYPES_H
 
+#include "file_table.h"
+#include "frame_memory.h"
 #include <string>
 #include <vector>
+#include <memory>
+#include <cstdint>
+
+// Pixel layout of the stored previews. Grayscale files are kept single-channel
+// (8- or 16-bit) and only expanded to RGB when drawn (see ColorLut).
+enum class PixelFormat {
+    RGB8,       // 3 bytes per pixel (RGB, or BGR on Windows)
+    Gray8,      // 1 byte per pixel
+    Gray16      // 2 bytes per pixel, native-endian uint16_t
+};
+
+inline const char* PixelFormatName(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::Gray8:  return "gray8";
+        case PixelFormat::Gray16: return "gray16";
+        default:                  return "rgb8";
+    }
+}
+
+inline int BytesPerPixel(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::Gray8:  return 1;
+        case PixelFormat::Gray16: return 2;
+        default:                  return 3;
+    }
+}
+
+// How preview frames are kept in RAM (see frame_store.h)
+enum class FrameCompression {
+    Off,        // Raw pixels
+    RLE,        // Delta against the run's keyframe, run-length coded
+    LZ4         // Delta against the run's keyframe, LZ4 coded (builds with HAVE_LZ4)
+};
+
+inline const char* FrameCompressionName(FrameCompression mode) {
+    switch (mode) {
+        case FrameCompression::RLE: return "rle";
+        case FrameCompression::LZ4: return "lz4";
+        default:                    return "off";
+    }
+}
+
+struct Histogram;
 
 // Structure to hold image data
 struct ImageFrame {
     std::string filename;
-    int index;              // The numeric part (e.g., 000100 -> 100)
-    unsigned char* data;
+    int64_t index;          // The numeric part (e.g., 000100 -> 100)
+    unsigned char* data;    // Preview pixels in the collection's PixelFormat, or packed (see below);
+                            // allocated with AllocFrameBuffer
+    std::shared_ptr<const Histogram> histogram;  // Of the preview's samples (gray formats only)
+    
+    // Packed frames (see frame_store.h): data holds packedBytes bytes; delta frames
+    // also point at the data of the keyframe they were packed against, which lives
+    // in the same sequence
+    uint32_t packedBytes = 0;               // 0 = data holds the raw pixels
+    const unsigned char* keyframe = nullptr;
+    uint32_t keyframeBytes = 0;             // packedBytes of the keyframe
     
     ImageFrame() : index(0), data(nullptr) {}
 };
 
+// How the visible window region is mapped onto an export frame
+// whose aspect ratio differs from the window's
+enum class ExportAspect {
+    Fit,        // Whole visible region is exported, letterboxed with black
+    Fill,       // Export frame is filled, the visible region is cropped
+    Stretch     // X and Y are scaled independently
+};
+
+inline const char* ExportAspectName(ExportAspect aspect) {
+    switch (aspect) {
+        case ExportAspect::Fill:    return "fill";
+        case ExportAspect::Stretch: return "stretch";
+        default:                    return "fit";
+    }
+}
+
+// Export output format
+enum class ExportFormat {
+    H264,       // ffmpeg/libx264 MP4 (default)
+    FFV1,       // ffmpeg FFV1 lossless in Matroska
+    Raw,        // Raw RGB24 frames, file or stdout
+    Y4M,        // YUV4MPEG2 4:4:4 stream, file or stdout
+    PNG         // PNG sequence, written in parallel by the render workers
+};
+
+inline const char* ExportFormatName(ExportFormat format) {
+    switch (format) {
+        case ExportFormat::FFV1: return "ffv1";
+        case ExportFormat::Raw:  return "raw";
+        case ExportFormat::Y4M:  return "y4m";
+        case ExportFormat::PNG:  return "png";
+        default:                 return "h264";
+    }
+}
+
+// Plane shown in 3D mode: the loaded z-slices, or a cross-section through the z-stack
+enum class SliceView {
+    XY,         // Current z-slice (default)
+    XZ,         // Row through all z-slices, highest z at the top
+    YZ,         // Column through all z-slices, highest z at the top
+    Projection  // Per-pixel reduction over all z-slices (see ProjectionOp)
+};
+
+inline const char* SliceViewName(SliceView view) {
+    switch (view) {
+        case SliceView::XZ:         return "XZ";
+        case SliceView::YZ:         return "YZ";
+        case SliceView::Projection: return "projection";
+        default:                    return "XY";
+    }
+}
+
+// Reduction used by the z projection view
+enum class ProjectionOp {
+    Max,        // Maximum intensity projection
+    Min,        // Minimum intensity projection
+    Mean        // Average over z
+};
+
+inline const char* ProjectionOpName(ProjectionOp op) {
+    switch (op) {
+        case ProjectionOp::Min:  return "min";
+        case ProjectionOp::Mean: return "mean";
+        default:                 return "max";
+    }
+}
+
 // Application settings (can be set via command line)
 struct AppSettings {
     int windowWidth = 1000;
     int windowHeight = 1000;
     int shrinkFactor = 0;       // 0 = auto-calculate based on window size
     int nthFrame = 1;           // Load every n-th frame (1 = all frames)
-    int numThreads = 72;        // Number of threads for loading and export
+    int numThreads = 0;         // Decode threads for loading, base of the export share (0 = CPUs available)
+    int ioThreads = 8;          // Read-ahead threads hinting files ahead of the decoders (0 = off)
+    int exportThreads = 0;      // Export render threads (0 = exportCPUShare of numThreads)
+    int encodeThreads = 0;      // ffmpeg thread budget of an export (0 = same as exportThreads)
+    bool pinThreads = false;    // Pin decode, z-loader and export workers to CPUs
     std::string initialFolder;  // Starting folder (empty = prompt or current dir)
     bool mode3D = false;        // 3D mode: folder contains z-subfolders
     bool debugMode = false;     // Show debug output
-    
+    int zCacheMB = 0;           // 3D mode: memory for resident z-slices (0 = half of physical RAM)
+    bool watchFolder = false;   // 2D mode: add frames written to the folder while the viewer runs
+    bool watchFollow = false;   // Watch mode: jump to the newest frame as frames arrive
+    bool forceRGB = false;      // Store grayscale previews as RGB8 instead of 1-channel 8/16-bit
+    FrameCompression frameCompression = FrameCompression::Off;  // 2D mode: packed previews
+    bool frameCompressionSet = false;  // --compress given (--mem-budget then leaves it alone)
+    int keyframeInterval = 8;   // With compression: frames per keyframe
+    HugePageMode hugePages = HugePageMode::Off;     // Backing of large preview buffers
+    NumaPlacement numaPlacement = NumaPlacement::Off;  // NUMA node policy of large preview buffers
+    int memBudgetMB = 0;        // Preview RAM to plan shrink, stride and compression for (0 = off)
+    std::string colormap = "gray"; // Initial colormap for grayscale frames: built-in name or LUT file
+    double levelsLow = -1.0;    // Initial levels window in sample values (-1 = full range)
+    double levelsHigh = -1.0;
+    bool autoLevels = false;    // Initial levels window from the sequence histogram
+
+    // Export output (independent of the preview window)
+    int exportWidth = 0;        // 0 = same as window width
+    int exportHeight = 0;       // 0 = same as window height
+    int exportFPS = 30;
+    ExportAspect exportAspect = ExportAspect::Fit;
+    int exportSegments = 1;     // Parallel encoder processes (segments are concatenated)
+    ExportFormat exportFormat = ExportFormat::H264;
+    std::string exportOutput;   // Output file/directory (empty = next to the images, "-" = stdout)
+    int exportCheckpoint = 0;   // Frames per checkpointed segment (0 = no checkpoints)
+    bool exportResume = false;  // Resume an interrupted export from its manifest
+    bool batchExport = false;   // Export the starting view without a window, then exit
+    double exportCPUShare = 0.5; // Fraction of numThreads used by background exports
+
     // Zoom limits
     double minZoom = 1.0;
     double maxZoom = 10.0;
@@ -48,77 +200,122 @@ struct ViewState {
     int frameCount = 0;
     double fpsAccumulator = 0.0;
     
+    // 3D mode cross-sections
+    SliceView sliceView = SliceView::XY;
+    double cutX = 0.5;          // YZ cut position as a fraction of the image width
+    double cutY = 0.5;          // XZ cut position as a fraction of the image height
+    ProjectionOp projectionOp = ProjectionOp::Max;
+    
+    // Grayscale frames: index into the viewer's colormap list, and the levels window
+    // (samples from levelLow to levelHigh, as fractions of the full range, span the colormap)
+    int colormap = 0;
+    double levelLow = 0.0;
+    double levelHigh = 1.0;
+    bool isLeveling = false;    // Right mouse drag adjusts the levels window
+    
     void reset() {
         zoomLevel = 1.0;
         panX = 0.0;
         panY = 0.0;
+        cutX = 0.5;
+        cutY = 0.5;
     }
 };
 
+// Non-owning view of a run of frames; valid until the owning vector is reassigned
+struct FrameSpan {
+    ImageFrame* first = nullptr;
+    size_t count = 0;
+    
+    FrameSpan() = default;
+    explicit FrameSpan(std::vector<ImageFrame>& frames) : first(frames.data()), count(frames.size()) {}
+    
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    ImageFrame& operator[](size_t i) const { return first[i]; }
+    ImageFrame* begin() const { return first; }
+    ImageFrame* end() const { return first + count; }
+};
+
 // Image collection state
+// Frame data has exactly one owner: in 2D mode `frames`, in 3D mode the per z-height
+// vectors in `zFrames` (`frames` stays empty). The active sequence is accessed through
+// activeFrames()/activeFiles(), so switching z copies nothing.
 struct ImageCollection {
-    std::vector<ImageFrame> frames;
-    std::vector<std::string> allFilePaths;  // All files for full-quality export
+    std::vector<ImageFrame> frames;         // 2D mode: loaded frames
+    FileTable allFiles;                     // 2D mode: all files for full-quality export
     int currentFrame = 0;
     int imageWidth = 0;
     int imageHeight = 0;
     int originalImageWidth = 0;   // Original (non-shrunk) dimensions
     int originalImageHeight = 0;
+    PixelFormat pixelFormat = PixelFormat::RGB8;   // Of every preview frame
     std::string currentFolder;
     
     // 3D mode: z-height navigation
     std::vector<int> zHeights;           // Available z-heights (sorted)
     int currentZIndex = 0;               // Index into zHeights vector
-    std::vector<std::vector<std::string>> zAllFilePaths;  // Per z-height file paths
-    std::vector<std::vector<ImageFrame>> zFrames;  // Per z-height loaded frames (all in memory)
-    bool using3DMode = false;  // Flag to indicate frames points into zFrames (don't double-free)
+    std::vector<FileTable> zAllFiles;    // Per z-height files
+    std::vector<std::vector<ImageFrame>> zFrames;  // Per z-height loaded frames (empty until resident)
+    bool using3DMode = false;  // Frames are owned per z-height by zFrames
     
-    bool isEmpty() const { 
-        if (using3DMode && currentZIndex < (int)zFrames.size()) {
-            return zFrames[currentZIndex].empty();
+    // Frames of the 2D sequence or of the current z-height
+    FrameSpan activeFrames() {
+        if (using3DMode) {
+            if (currentZIndex < (int)zFrames.size()) {
+                return FrameSpan(zFrames[currentZIndex]);
+            }
+            return FrameSpan();
+        }
+        return FrameSpan(frames);
+    }
+    
+    // Full-resolution files of the 2D sequence or of the current z-height
+    const FileTable& activeFiles() const {
+        if (using3DMode && currentZIndex < (int)zAllFiles.size()) {
+            return zAllFiles[currentZIndex];
         }
-        return frames.empty(); 
+        return allFiles;
+    }
+    
+    // Bytes of one preview frame
+    size_t frameBytes() const {
+        return (size_t)imageWidth * imageHeight * BytesPerPixel(pixelFormat);
     }
     
+    bool isEmpty() const { return size() == 0; }
+    
     size_t size() const { 
-        if (using3DMode && currentZIndex < (int)zFrames.size()) {
-            return zFrames[currentZIndex].size();
+        if (using3DMode) {
+            return currentZIndex < (int)zFrames.size() ? zFrames[currentZIndex].size() : 0;
         }
         return frames.size(); 
     }
     
     void cleanup() {
-        // In 3D mode, only cleanup zFrames (frames is just a copy/reference)
-        if (using3DMode) {
-            for (auto& zFrameList : zFrames) {
-                for (auto& frame : zFrameList) {
-                    if (frame.data) {
-                        delete[] frame.data;
-                        frame.data = nullptr;
-                    }
-                }
-            }
-            frames.clear(); // Just clear the vector, don't delete data
-        } else {
-            // In 2D mode, cleanup frames normally
-            for (auto& frame : frames) {
-                if (frame.data) {
-                    delete[] frame.data;
-                    frame.data = nullptr;
-                }
+        // Each frame has a single owner, so both sets can be freed unconditionally
+        for (auto& frame : frames) {
+            FreeFrameBuffer(frame.data);
+            frame.data = nullptr;
+        }
+        for (auto& zFrameList : zFrames) {
+            for (auto& frame : zFrameList) {
+                FreeFrameBuffer(frame.data);
+                frame.data = nullptr;
             }
         }
         
         frames.clear();
-        allFilePaths.clear();
+        allFiles = FileTable();
         currentFrame = 0;
         imageWidth = 0;
         imageHeight = 0;
         originalImageWidth = 0;
         originalImageHeight = 0;
+        pixelFormat = PixelFormat::RGB8;
         zHeights.clear();
         currentZIndex = 0;
-        zAllFilePaths.clear();
+        zAllFiles.clear();
         zFrames.clear();
         using3DMode = false;
     }
@@ -0,0 +1,111 @@
+// Sample histogram implementation
+
+#include "histogram.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+// Smallest bin width (as a shift) that fits [minValue, maxValue] into kBins bins
+static int ShiftForRange(unsigned minValue, unsigned maxValue) {
+    int shift = 0;
+    while (((maxValue - minValue) >> shift) >= (unsigned)Histogram::kBins) {
+        shift++;
+    }
+    return shift;
+}
+
+// Add source's counts to target, whose range covers source's; each source bin goes
+// to the target bin holding its lowest value
+static void Rebin(const Histogram& source, Histogram& target) {
+    for (int b = 0; b < Histogram::kBins; ++b) {
+        if (source.bins[b] == 0) continue;
+        unsigned value = source.base + ((unsigned)b << source.shift);
+        target.bins[(value - target.base) >> target.shift] += source.bins[b];
+    }
+    target.samples += source.samples;
+}
+
+// Empty histogram with bins over [minValue, maxValue]
+static void SetRange(Histogram& histogram, unsigned minValue, unsigned maxValue) {
+    histogram = Histogram();
+    histogram.minValue = minValue;
+    histogram.maxValue = maxValue;
+    histogram.base = minValue;
+    histogram.shift = ShiftForRange(minValue, maxValue);
+}
+
+double Histogram::percentile(double fraction) const {
+    if (samples == 0) return 0.0;
+    double binWidth = (double)(1u << shift);
+    double target = std::clamp(fraction, 0.0, 1.0) * samples;
+    double below = 0.0;
+    double value = maxValue;
+    for (int b = 0; b < kBins; ++b) {
+        if (bins[b] > 0 && below + bins[b] >= target) {
+            value = base + (b + (target - below) / bins[b]) * binWidth;
+            break;
+        }
+        below += bins[b];
+    }
+    return std::clamp(value, (double)minValue, (double)maxValue);
+}
+
+// Two passes over the (still cached) samples: the range, then the counts. Four
+// partial tables, so runs of equal samples do not serialise on one counter.
+template <typename Sample>
+static void CountSamples(const Sample* src, size_t count, Histogram& histogram) {
+    Sample lo = std::numeric_limits<Sample>::max(), hi = 0;
+    for (size_t i = 0; i < count; ++i) {
+        lo = std::min(lo, src[i]);
+        hi = std::max(hi, src[i]);
+    }
+    if (count == 0) return;
+    SetRange(histogram, lo, hi);
+
+    uint32_t partial[4][Histogram::kBins];
+    memset(partial, 0, sizeof(partial));
+    int shift = histogram.shift;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        partial[0][(src[i] - lo) >> shift]++;
+        partial[1][(src[i + 1] - lo) >> shift]++;
+        partial[2][(src[i + 2] - lo) >> shift]++;
+        partial[3][(src[i + 3] - lo) >> shift]++;
+    }
+    for (; i < count; ++i) {
+        partial[0][(src[i] - lo) >> shift]++;
+    }
+    for (int b = 0; b < Histogram::kBins; ++b) {
+        histogram.bins[b] = (uint64_t)partial[0][b] + partial[1][b] + partial[2][b] + partial[3][b];
+    }
+    histogram.samples = count;
+}
+
+std::shared_ptr<const Histogram> ComputeHistogram(const unsigned char* pixels, size_t count, PixelFormat format) {
+    if (!pixels || format == PixelFormat::RGB8) return nullptr;
+    auto histogram = std::make_shared<Histogram>();
+    if (format == PixelFormat::Gray16) {
+        CountSamples((const uint16_t*)pixels, count, *histogram);
+    } else {
+        CountSamples(pixels, count, *histogram);
+    }
+    return histogram;
+}
+
+Histogram SequenceHistogram(const FrameSpan& frames) {
+    // Bins over the range of all frames, so each frame is re-binned only once
+    unsigned lo = ~0u, hi = 0;
+    for (const ImageFrame& frame : frames) {
+        if (frame.histogram && frame.histogram->samples > 0) {
+            lo = std::min(lo, frame.histogram->minValue);
+            hi = std::max(hi, frame.histogram->maxValue);
+        }
+    }
+    Histogram sum;
+    if (lo > hi) return sum;
+    SetRange(sum, lo, hi);
+    for (const ImageFrame& frame : frames) {
+        if (frame.histogram) Rebin(*frame.histogram, sum);
+    }
+    return sum;
+}
@@ -0,0 +1,41 @@
+// Sample histograms for PNG Image Viewer
+// Grayscale previews are histogrammed by the thread that decoded them, while the
+// pixels are still in its cache; levels windows are then taken from percentiles of a
+// frame or of the whole sequence without another pass over the pixels
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "frame_types.h"
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+// The bins cover the samples' own range, so a 16-bit field that only uses a few
+// thousand values still gets 256 bins across them
+struct Histogram {
+    static const int kBins = 256;
+    uint64_t bins[kBins] = {};
+    uint64_t samples = 0;
+    unsigned minValue = ~0u;    // Exact range of the samples
+    unsigned maxValue = 0;
+    unsigned base = 0;          // Sample value at the start of bin 0 (minValue)
+    int shift = 0;              // Bins are 1 << shift sample values wide
+
+    // Sample value below which `fraction` of the samples lie, interpolated within its
+    // bin and kept inside [minValue, maxValue]
+    double percentile(double fraction) const;
+};
+
+// Histogram of `count` gray samples; nullptr for RGB8 frames, which have none
+std::shared_ptr<const Histogram> ComputeHistogram(const unsigned char* pixels, size_t count, PixelFormat format);
+
+// Sum of the frames' histograms (frames without one are skipped)
+Histogram SequenceHistogram(const FrameSpan& frames);
+
+// Largest sample value of a format (255 for Gray8 and RGB8, 65535 for Gray16)
+inline unsigned MaxSampleValue(PixelFormat format) {
+    return format == PixelFormat::Gray16 ? 65535u : 255u;
+}
+
+#endif // HISTOGRAM_H
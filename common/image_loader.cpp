@@ -2,64 +2,110 @@
 // Platform-independent image loading with stb_image
 
 #include "image_loader.h"
+#include "file_io.h"
+#include "bounded_queue.h"
+#include "png_decoder.h"
+#include "histogram.h"
+#include "frame_store.h"
+#include "thread_pool.h"
 #include "stb_image.h"
 #include <iostream>
+#include <iomanip>
 #include <thread>
 #include <mutex>
+#include <chrono>
+#include <cstring>
 #include <algorithm>
-#include <cctype>
 
 // Global interrupt flag - can be set by signal handler
 std::atomic<bool> g_interrupted(false);
 
-int ExtractIndex(const std::string& filename) {
-    size_t dotPos = filename.rfind('.');
-    if (dotPos == std::string::npos) return -1;
-    
-    // Find the last underscore before the extension
-    size_t lastUnderscore = filename.rfind('_', dotPos);
-    if (lastUnderscore == std::string::npos) return -1;
-    
-    std::string numStr = filename.substr(lastUnderscore + 1, dotPos - lastUnderscore - 1);
-    
-    // Verify it's all digits
-    for (char c : numStr) {
-        if (!std::isdigit(static_cast<unsigned char>(c))) return -1;
+int64_t ExtractIndex(const std::string& filename) {
+    return ParseFrameIndex(filename.data(), filename.size());
+}
+
+// stb_image converts to the requested format itself (luma for gray, 8 <-> 16 bit)
+static unsigned char* DecodeWithStb(const unsigned char* contents, size_t size, const std::string& filename,
+                                    int& width, int& height, PixelFormat format = PixelFormat::RGB8) {
+    int channels;
+    unsigned char* data = nullptr;
+    switch (format) {
+        case PixelFormat::Gray8:
+            data = stbi_load_from_memory(contents, (int)size, &width, &height, &channels, 1);
+            break;
+        case PixelFormat::Gray16:
+            data = (unsigned char*)stbi_load_16_from_memory(contents, (int)size, &width, &height, &channels, 1);
+            break;
+        default:
+            data = stbi_load_from_memory(contents, (int)size, &width, &height, &channels, 3);
+            break;
     }
-    
-    try {
-        return std::stoi(numStr);
-    } catch (...) {
-        return -1;
+    if (!data) {
+        std::cerr << "Error loading: " << filename << " - " << stbi_failure_reason() << std::endl;
     }
+    return data;
 }
 
-unsigned char* LoadAndShrinkImage(const std::string& filename, int shrinkFactor, 
-                                   int& outWidth, int& outHeight,
-                                   bool rgbOutput, bool flipVertical) {
-    int w, h, channels;
-    unsigned char* originalData = stbi_load(filename.c_str(), &w, &h, &channels, 3);
+// Decode to RGB8 with the built-in PNG decoder, or stb_image for files it does not handle
+static unsigned char* DecodeImage(const unsigned char* contents, size_t size, const std::string& filename,
+                                  int& width, int& height) {
+    unsigned char* data = DecodePNG(contents, size, width, height);
+    if (!data) {
+        data = DecodeWithStb(contents, size, filename, width, height);
+    }
+    return data;
+}
+
+unsigned char* LoadImageFile(const std::string& filename, int& width, int& height) {
+    // The compressed file is read in one go into a per-thread buffer that is reused
+    thread_local std::vector<unsigned char> contents;
+    if (!ReadFileContents(filename, contents)) {
+        return nullptr;
+    }
+    return DecodeImage(contents.data(), contents.size(), filename, width, height);
+}
+
+void FreeImage(unsigned char* data) {
+    // Both decoders allocate with malloc
+    stbi_image_free(data);
+}
+
+unsigned char* DecodeAndShrinkImage(const unsigned char* contents, size_t size, const std::string& filename,
+                                    int shrinkFactor, int& outWidth, int& outHeight,
+                                    bool rgbOutput, bool flipVertical, PixelFormat format) {
+    // The built-in decoder shrinks while unfiltering; other files are decoded in full
+    // by stb_image and then shrunk
+    unsigned char* shrunk = DecodePNGShrunk(contents, size, shrinkFactor, format, rgbOutput, flipVertical,
+                                            outWidth, outHeight);
+    if (shrunk) {
+        return shrunk;
+    }
     
+    int w, h;
+    unsigned char* originalData = DecodeWithStb(contents, size, filename, w, h, format);
     if (!originalData) {
-        std::cerr << "Error loading: " << filename << " - " << stbi_failure_reason() << std::endl;
         return nullptr;
     }
     
     int newWidth = w / shrinkFactor;
     int newHeight = h / shrinkFactor;
+    int bpp = BytesPerPixel(format);
     
-    unsigned char* outputData = new unsigned char[newWidth * newHeight * 3];
+    unsigned char* outputData = AllocFrameBuffer((size_t)newWidth * newHeight * bpp);
     
     for (int y = 0; y < newHeight; y++) {
         for (int x = 0; x < newWidth; x++) {
             int srcX = x * shrinkFactor;
             int srcY = y * shrinkFactor;
-            int srcIdx = (srcY * w + srcX) * 3;
+            int srcIdx = (srcY * w + srcX) * bpp;
             
             int dstY = flipVertical ? (newHeight - 1 - y) : y;
-            int dstIdx = (dstY * newWidth + x) * 3;
+            int dstIdx = (dstY * newWidth + x) * bpp;
             
-            if (rgbOutput) {
+            if (format != PixelFormat::RGB8) {
+                // Gray: one 8- or 16-bit sample
+                memcpy(outputData + dstIdx, originalData + srcIdx, bpp);
+            } else if (rgbOutput) {
                 // RGB output (Linux/SDL2)
                 outputData[dstIdx + 0] = originalData[srcIdx + 0];  // R
                 outputData[dstIdx + 1] = originalData[srcIdx + 1];  // G
@@ -73,13 +119,39 @@ unsigned char* LoadAndShrinkImage(const std::string& filename, int shrinkFactor,
         }
     }
     
-    stbi_image_free(originalData);
+    FreeImage(originalData);
     
     outWidth = newWidth;
     outHeight = newHeight;
     return outputData;
 }
 
+unsigned char* LoadAndShrinkImage(const std::string& filename, int shrinkFactor, 
+                                   int& outWidth, int& outHeight,
+                                   bool rgbOutput, bool flipVertical, PixelFormat format) {
+    thread_local std::vector<unsigned char> contents;
+    if (!ReadFileContents(filename, contents)) {
+        return nullptr;
+    }
+    return DecodeAndShrinkImage(contents.data(), contents.size(), filename, shrinkFactor,
+                                outWidth, outHeight, rgbOutput, flipVertical, format);
+}
+
+PixelFormat ProbePixelFormat(const std::string& probeFilePath) {
+    int probeW, probeH, probeChannels;
+    FILE* file = fopen(probeFilePath.c_str(), "rb");
+    if (!file) {
+        return PixelFormat::RGB8;
+    }
+    PixelFormat format = PixelFormat::RGB8;
+    if (stbi_info_from_file(file, &probeW, &probeH, &probeChannels) && probeChannels <= 2) {
+        // Gray or gray+alpha (alpha is dropped, as for RGB previews)
+        format = stbi_is_16_bit_from_file(file) ? PixelFormat::Gray16 : PixelFormat::Gray8;
+    }
+    fclose(file);
+    return format;
+}
+
 int AutoCalculateShrinkFactor(const std::string& probeFilePath, int windowWidth, int windowHeight) {
     int probeW, probeH, probeChannels;
     if (stbi_info(probeFilePath.c_str(), &probeW, &probeH, &probeChannels)) {
@@ -105,15 +177,461 @@ int AutoCalculateShrinkFactor(const std::string& probeFilePath, int windowWidth,
     return 4;
 }
 
+// Raw over packed size of previews `stride` files apart, packed in runs of
+// keyframeInterval, estimated from the first keyframe and the delta that follows it
+static double EstimateCompressionRatio(const FileTable& files, int shrinkFactor, int stride, PixelFormat format,
+                                       FrameCompression mode, int keyframeInterval) {
+    if (files.size() < 2 || keyframeInterval < 2) return 1.0;
+    int w = 0, h = 0, dw = 0, dh = 0;
+    unsigned char* key = LoadAndShrinkImage(files.path(0), shrinkFactor, w, h, true, false, format);
+    unsigned char* next = LoadAndShrinkImage(files.path(std::min((size_t)stride, files.size() - 1)), shrinkFactor,
+                                             dw, dh, true, false, format);
+    double ratio = 1.0;
+    if (key && next && w == dw && h == dh) {
+        size_t bytes = (size_t)w * h * BytesPerPixel(format);
+        uint32_t keyBytes = 0, deltaBytes = 0;
+        FreeFrameBuffer(PackFrame(mode, key, bytes, nullptr, keyBytes));
+        FreeFrameBuffer(PackFrame(mode, next, bytes, key, deltaBytes));
+        double keyStored = keyBytes > 0 ? keyBytes : bytes;
+        double deltaStored = deltaBytes > 0 ? deltaBytes : bytes;
+        ratio = (double)bytes * keyframeInterval / (keyStored + deltaStored * (keyframeInterval - 1));
+    }
+    FreeFrameBuffer(key);
+    FreeFrameBuffer(next);
+    return ratio;
+}
+
+PreviewMemoryPlan PlanPreviewMemory(const FileTable& files, PixelFormat format, size_t budgetBytes,
+                                    int shrinkFactor, int nthFrame, int windowWidth, int windowHeight,
+                                    bool allowCompression, FrameCompression compressionMode,
+                                    int keyframeInterval) {
+    PreviewMemoryPlan plan;
+    plan.nthFrame = std::max(1, nthFrame);
+    plan.shrinkFactor = std::max(1, shrinkFactor);
+    int probeW = 0, probeH = 0;
+    if (files.empty() || !stbi_info(files.path(0).c_str(), &probeW, &probeH, nullptr)) {
+        plan.frames = files.previewCount(plan.nthFrame);
+        return plan;
+    }
+    
+    // Auto shrink starts at ~2x window size and may go down to about the window size
+    int maxShrink = plan.shrinkFactor;
+    if (shrinkFactor <= 0) {
+        plan.shrinkFactor = std::max(1, std::max(probeW / (windowWidth * 2), probeH / (windowHeight * 2)));
+        maxShrink = std::max(plan.shrinkFactor, std::max(probeW / windowWidth, probeH / windowHeight));
+    }
+    auto previewBytes = [&](int shrink) {
+        return (double)(probeW / shrink) * (probeH / shrink) * BytesPerPixel(format);
+    };
+    // What one stored preview really takes, page rounding of mapped buffers included
+    auto frameFootprint = [&](int shrink) {
+        return FrameBufferFootprint((size_t)(previewBytes(shrink) / plan.compressionRatio));
+    };
+    auto estimate = [&]() {
+        plan.frames = files.previewCount(plan.nthFrame);
+        plan.bytes = plan.frames * frameFootprint(plan.shrinkFactor);
+        return plan.bytes <= budgetBytes;
+    };
+    if (estimate()) {
+        plan.fits = true;
+        return plan;
+    }
+    
+    // Lossless first: keep resolution and every frame if packing saves enough
+    if (allowCompression && compressionMode != FrameCompression::Off) {
+        double ratio = EstimateCompressionRatio(files, plan.shrinkFactor, plan.nthFrame, format,
+                                                compressionMode, keyframeInterval);
+        if (ratio > 1.1) {
+            plan.compression = compressionMode;
+            plan.compressionRatio = ratio;
+            if (estimate()) {
+                plan.fits = true;
+                return plan;
+            }
+        }
+    }
+    
+    while (plan.shrinkFactor < maxShrink && !estimate()) {
+        plan.shrinkFactor++;
+    }
+    if (estimate()) {
+        plan.fits = true;
+        return plan;
+    }
+    
+    // Then every n-th frame, as many as the budget holds
+    size_t perFrame = frameFootprint(plan.shrinkFactor);
+    size_t maxFrames = perFrame > 0 ? budgetBytes / perFrame : 0;
+    plan.budgetFrames = maxFrames;
+    if (maxFrames == 0) {
+        return plan;
+    }
+    // The last frame is always added, so ceil(size / maxFrames) is only where the
+    // search starts: take the smallest stride whose count, last frame included, fits
+    size_t lastStride = std::max<size_t>(1, std::min<size_t>(INT32_MAX, files.size() - 1));
+    size_t stride = std::max<size_t>(plan.nthFrame, (files.size() + maxFrames - 1) / maxFrames);
+    while (stride < lastStride && files.previewCount((int)stride) > maxFrames) {
+        stride++;
+    }
+    plan.nthFrame = (int)std::min(stride, lastStride);
+    plan.fits = estimate();
+    return plan;
+}
+
+void PrintPreviewMemoryPlan(const PreviewMemoryPlan& plan, size_t budgetBytes) {
+    std::cout << "Memory budget: " << (budgetBytes / (1024 * 1024)) << " MB -> shrink " << plan.shrinkFactor
+              << ", every " << plan.nthFrame << "-th frame (" << plan.frames << " previews)";
+    if (plan.compression != FrameCompression::Off) {
+        std::cout << ", " << FrameCompressionName(plan.compression) << " compressed (~"
+                  << std::fixed << std::setprecision(1) << plan.compressionRatio << "x)"
+                  << std::defaultfloat << std::setprecision(6);
+    }
+    std::cout << ", ~" << (plan.bytes / (1024 * 1024)) << " MB" << std::endl;
+    if (!plan.fits && plan.budgetFrames == 0) {
+        std::cerr << "Warning: a single preview exceeds the memory budget" << std::endl;
+    } else if (!plan.fits) {
+        std::cerr << "Warning: the memory budget holds " << plan.budgetFrames
+                  << " preview(s), fewer than the first and last frame" << std::endl;
+    }
+}
+
+// Loading runs as a pipeline: read threads fill a bounded queue with compressed
+// files, decode tasks on the shared pool turn them into previews, and the calling
+// thread stores the previews and reports progress. Without read threads the decode
+// tasks read for themselves. Files are handed out in runs of consecutive files; with
+// compression a run is one keyframe followed by the frames packed as deltas against
+// it, so a run is one task.
+bool LoadFrameList(
+    const std::vector<std::string>& files,
+    int shrinkFactor,
+    int ioThreads,
+    bool rgbOutput,
+    bool flipVertical,
+    PixelFormat format,
+    FrameCompression compression,
+    int keyframeInterval,
+    std::vector<ImageFrame>& frames,
+    int& width,
+    int& height,
+    ProgressCallback progressCallback,
+    LoadPipelineStats* stats
+) {
+    using Clock = std::chrono::steady_clock;
+    auto secondsSince = [](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    auto loadStart = Clock::now();
+    
+    frames.assign(files.size(), ImageFrame());
+    width = 0;
+    height = 0;
+    
+    struct CompressedFile {
+        size_t index = 0;
+        std::vector<unsigned char> contents;
+        bool ok = false;
+    };
+    struct Preview {
+        size_t index = 0;
+        unsigned char* data = nullptr;
+        int width = 0;
+        int height = 0;
+        std::shared_ptr<const Histogram> histogram;
+        uint32_t packedBytes = 0;
+        const unsigned char* keyframe = nullptr;
+        uint32_t keyframeBytes = 0;
+    };
+    
+    size_t runLength = (compression == FrameCompression::Off) ? 1 : (size_t)std::max(1, keyframeInterval);
+    size_t numRuns = (files.size() + runLength - 1) / runLength;
+    // Decoding runs on the shared pool, one task per run
+    ThreadPool& pool = SharedThreadPool();
+    int decodeThreads = std::max(1, std::min(pool.size(), (int)numRuns));
+    int readThreads = std::min(ioThreads, (int)numRuns);
+    BoundedQueue<std::vector<CompressedFile>> readQueue(std::max<size_t>(decodeThreads, decodeThreads * 2 / runLength));
+    BoundedQueue<Preview> previewQueue((size_t)decodeThreads * 2);
+    
+    std::atomic<bool> cancelled(false);
+    auto stopRequested = [&]() { return g_interrupted.load() || cancelled.load(); };
+    std::atomic<size_t> nextRun(0);
+    std::atomic<int> readersLeft(readThreads);
+    
+    LoadPipelineStats totals;
+    std::mutex statsMutex;
+    
+    // Decode tasks not yet finished, plus one until all of them are submitted;
+    // whoever brings it to zero closes the preview queue
+    std::atomic<size_t> outstanding(1);
+    auto finishOne = [&]() {
+        if (--outstanding == 0) {
+            previewQueue.close();
+        }
+    };
+    
+    auto readRun = [&](size_t run, std::vector<CompressedFile>& contents, LoadStageStats& stage) {
+        size_t first = run * runLength;
+        size_t last = std::min(files.size(), first + runLength);
+        contents.resize(last - first);
+        for (size_t i = first; i < last; ++i) {
+            auto start = Clock::now();
+            CompressedFile& file = contents[i - first];
+            file.index = i;
+            file.ok = ReadFileContents(files[i], file.contents);
+            stage.files++;
+            stage.bytes += file.contents.size();
+            stage.busySeconds += secondsSince(start);
+        }
+    };
+    
+    // Stage 2: decode and shrink one run from memory, then pack if compressing
+    auto decodeRun = [&](std::vector<CompressedFile>& contents) {
+        LoadStageStats stage;
+        thread_local std::vector<unsigned char> keyPixels;
+        
+        // The run's first decoded frame is its keyframe
+        const unsigned char* keyframe = nullptr;
+        uint32_t keyframeBytes = 0;
+        int keyWidth = 0, keyHeight = 0;
+        for (CompressedFile& file : contents) {
+            // After a cancel the remaining tasks only drain the read queue
+            if (stopRequested()) break;
+            
+            auto start = Clock::now();
+            Preview preview;
+            preview.index = file.index;
+            if (file.ok) {
+                preview.data = DecodeAndShrinkImage(file.contents.data(), file.contents.size(), files[file.index],
+                                                    shrinkFactor, preview.width, preview.height,
+                                                    rgbOutput, flipVertical, format);
+            }
+            size_t previewBytes = (size_t)preview.width * preview.height * BytesPerPixel(format);
+            if (preview.data) {
+                // Histogram while the preview is still in this thread's cache
+                preview.histogram = ComputeHistogram(preview.data, (size_t)preview.width * preview.height, format);
+                
+                if (compression != FrameCompression::Off) {
+                    bool delta = keyframe && preview.width == keyWidth && preview.height == keyHeight;
+                    uint32_t packedBytes = 0;
+                    unsigned char* packed = PackFrame(compression, preview.data, previewBytes,
+                                                      delta ? keyPixels.data() : nullptr, packedBytes);
+                    if (!delta) {
+                        keyPixels.assign(preview.data, preview.data + previewBytes);
+                        keyWidth = preview.width;
+                        keyHeight = preview.height;
+                    }
+                    if (packed) {
+                        FreeFrameBuffer(preview.data);
+                        preview.data = packed;
+                        preview.packedBytes = packedBytes;
+                    }
+                    if (delta) {
+                        preview.keyframe = keyframe;
+                        preview.keyframeBytes = keyframeBytes;
+                    } else {
+                        keyframe = preview.data;
+                        keyframeBytes = preview.packedBytes;
+                    }
+                }
+            }
+            stage.files++;
+            stage.bytes += previewBytes;
+            stage.busySeconds += secondsSince(start);
+            
+            if (!previewQueue.push(preview)) {
+                FreeFrameBuffer(preview.data);
+            }
+        }
+        
+        std::lock_guard<std::mutex> lock(statsMutex);
+        totals.decode.files += stage.files;
+        totals.decode.bytes += stage.bytes;
+        totals.decode.busySeconds += stage.busySeconds;
+    };
+    
+    // Declared after everything its tasks use, so it is destroyed (waited for) first
+    TaskGroup decodeTasks(pool, TaskPriority::Loading);
+    
+    // Stage 1: whole-file reads, in list order; each run read is followed by a
+    // decode task for one queued run, so decode tasks never wait for a read
+    auto readWorker = [&]() {
+        LoadStageStats stage;
+        for (size_t run = nextRun++; run < numRuns && !stopRequested(); run = nextRun++) {
+            std::vector<CompressedFile> contents;
+            readRun(run, contents, stage);
+            if (!readQueue.push(std::move(contents))) break;
+            outstanding++;
+            decodeTasks.run([&]() {
+                std::vector<CompressedFile> queued;
+                if (readQueue.pop(queued)) {
+                    decodeRun(queued);
+                }
+                finishOne();
+            });
+        }
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            totals.read.files += stage.files;
+            totals.read.bytes += stage.bytes;
+            totals.read.busySeconds += stage.busySeconds;
+        }
+        if (--readersLeft == 0) {
+            finishOne();
+        }
+    };
+    
+    // Read threads block on I/O, so they are not pool tasks
+    std::vector<std::thread> threads;
+    for (int t = 0; t < readThreads; t++) {
+        threads.emplace_back(readWorker);
+    }
+    
+    // Without read threads each decode task reads its own run
+    if (readThreads == 0) {
+        for (size_t run = 0; run < numRuns; ++run) {
+            outstanding++;
+            decodeTasks.run([&, run]() {
+                if (!stopRequested()) {
+                    LoadStageStats readStage;
+                    std::vector<CompressedFile> contents;
+                    readRun(run, contents, readStage);
+                    {
+                        std::lock_guard<std::mutex> lock(statsMutex);
+                        totals.read.files += readStage.files;
+                        totals.read.bytes += readStage.bytes;
+                        totals.read.busySeconds += readStage.busySeconds;
+                    }
+                    decodeRun(contents);
+                }
+                finishOne();
+            });
+        }
+        finishOne();
+    }
+    
+    // Stage 3 (this thread): store previews in the frame list and report progress
+    int loadedCount = 0;
+    int firstWidth = 0, firstHeight = 0;
+    Preview preview;
+    while (previewQueue.pop(preview)) {
+        if (stopRequested()) {
+            FreeFrameBuffer(preview.data);
+            continue;
+        }
+        auto start = Clock::now();
+        if (preview.data) {
+            if (firstWidth == 0) {
+                firstWidth = preview.width;
+                firstHeight = preview.height;
+            }
+            
+            // Extract just the filename from path
+            const std::string& path = files[preview.index];
+            size_t lastSlash = path.find_last_of("/\\");
+            std::string filename = (lastSlash != std::string::npos) ? path.substr(lastSlash + 1) : path;
+            
+            ImageFrame& frame = frames[preview.index];
+            frame.filename = filename;
+            frame.index = ExtractIndex(filename);
+            frame.data = preview.data;
+            frame.histogram = std::move(preview.histogram);
+            frame.packedBytes = preview.packedBytes;
+            frame.keyframe = preview.keyframe;
+            frame.keyframeBytes = preview.keyframeBytes;
+            totals.store.bytes += StoredFrameBytes(frame, (size_t)preview.width * preview.height * BytesPerPixel(format));
+        }
+        totals.store.files++;
+        totals.store.busySeconds += secondsSince(start);
+        
+        loadedCount++;
+        if (progressCallback && !progressCallback(loadedCount, (int)files.size())) {
+            cancelled.store(true);
+        }
+    }
+    
+    // Wait for the readers and the decode tasks
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    decodeTasks.wait();
+    
+    if (stats) {
+        totals.read.threads = readThreads;
+        totals.decode.threads = decodeThreads;
+        totals.store.threads = 1;
+        totals.seconds = secondsSince(loadStart);
+        totals.queueCapacity = readQueue.capacity();
+        totals.readQueueMean = readQueue.meanOccupancy();
+        totals.readQueueMax = readQueue.maxOccupancy();
+        totals.previewQueueMean = previewQueue.meanOccupancy();
+        totals.previewQueueMax = previewQueue.maxOccupancy();
+        *stats = totals;
+    }
+    
+    if (stopRequested()) {
+        for (auto& frame : frames) {
+            FreeFrameBuffer(frame.data);
+        }
+        frames.clear();
+        return false;
+    }
+    
+    // Remove failed loads
+    frames.erase(
+        std::remove_if(frames.begin(), frames.end(),
+            [](const ImageFrame& f) { return f.data == nullptr; }),
+        frames.end()
+    );
+    
+    // Sort by index
+    std::sort(frames.begin(), frames.end(),
+        [](const ImageFrame& a, const ImageFrame& b) { return a.index < b.index; });
+    
+    width = firstWidth;
+    height = firstHeight;
+    return true;
+}
+
+void PrintLoadPipelineStats(const LoadPipelineStats& stats) {
+    double seconds = std::max(stats.seconds, 1e-9);
+    auto printStage = [&](const char* name, const LoadStageStats& stage, const char* bytesLabel) {
+        std::cout << "  " << name << ": ";
+        if (stage.threads == 0) {
+            std::cout << "in the decode threads, ";
+        } else {
+            std::cout << stage.threads << " thread(s), ";
+        }
+        int busyThreads = stage.threads > 0 ? stage.threads : stats.decode.threads;
+        std::cout << (stage.files / seconds) << " files/s, "
+                  << (stage.bytes / (1024.0 * 1024.0) / seconds) << " MB/s " << bytesLabel << ", "
+                  << (int)(100.0 * stage.busySeconds / (seconds * std::max(1, busyThreads))) << "% busy" << std::endl;
+    };
+    
+    std::ios_base::fmtflags savedFlags = std::cout.flags();
+    std::streamsize savedPrecision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Loading pipeline (" << std::setprecision(2) << stats.seconds << " s):" << std::setprecision(1) << std::endl;
+    printStage("Read  ", stats.read, "compressed");
+    printStage("Decode", stats.decode, "previews");
+    printStage("Store ", stats.store, "previews");
+    std::cout << "  Queues (capacity " << stats.queueCapacity << "): read mean " << stats.readQueueMean
+              << " / max " << stats.readQueueMax << ", decoded mean " << stats.previewQueueMean
+              << " / max " << stats.previewQueueMax << std::endl;
+    std::cout.flags(savedFlags);
+    std::cout.precision(savedPrecision);
+}
+
 bool LoadImagesCommon(
     ImageCollection& collection,
     const std::vector<std::string>& files,
-    const std::vector<std::string>& allFilePaths,
+    const FileTable& allFiles,
     const std::string& folder,
     int shrinkFactor,
-    int numThreads,
+    int ioThreads,
     bool rgbOutput,
     bool flipVertical,
+    PixelFormat format,
+    FrameCompression compression,
+    int keyframeInterval,
     ProgressCallback progressCallback,
     bool quietMode
 ) {
@@ -125,120 +643,53 @@ bool LoadImagesCommon(
     // Save z-height data before cleanup (for 3D mode)
     auto savedZHeights = collection.zHeights;
     int savedZIndex = collection.currentZIndex;
-    auto savedZAllFilePaths = collection.zAllFilePaths;
+    auto savedZAllFiles = std::move(collection.zAllFiles);
     
     collection.cleanup();
     collection.currentFolder = folder;
-    collection.allFilePaths = allFilePaths;
+    collection.allFiles = allFiles;
+    collection.pixelFormat = format;
     
     // Restore z-height data after cleanup (for 3D mode)
     collection.zHeights = savedZHeights;
     collection.currentZIndex = savedZIndex;
-    collection.zAllFilePaths = savedZAllFilePaths;
+    collection.zAllFiles = std::move(savedZAllFiles);
     
     if (!quietMode) {
         std::cout << "\nFolder: " << folder << std::endl;
-        std::cout << "Loading " << files.size() << " images with " << numThreads << " threads..." << std::endl;
-    }
-    
-    // Prepare frames vector
-    collection.frames.resize(files.size());
-    
-    std::mutex progressMutex;
-    int loadedCount = 0;
-    int firstWidth = 0, firstHeight = 0;
-    std::mutex dimMutex;
-    
-    // Worker function
-    auto loadWorker = [&](size_t startIdx, size_t endIdx) {
-        for (size_t i = startIdx; i < endIdx; i++) {
-            // Check for interrupt
-            if (g_interrupted.load()) {
-                return;
-            }
-            
-            int w, h;
-            unsigned char* data = LoadAndShrinkImage(files[i], shrinkFactor, w, h, rgbOutput, flipVertical);
-            
-            if (data) {
-                // Store first dimensions (thread-safe)
-                {
-                    std::lock_guard<std::mutex> lock(dimMutex);
-                    if (firstWidth == 0) {
-                        firstWidth = w;
-                        firstHeight = h;
-                    }
-                }
-                
-                // Extract just the filename from path
-                size_t lastSlash = files[i].find_last_of("/\\");
-                std::string filename = (lastSlash != std::string::npos) ? 
-                    files[i].substr(lastSlash + 1) : files[i];
-                
-                collection.frames[i].filename = filename;
-                collection.frames[i].index = ExtractIndex(filename);
-                collection.frames[i].data = data;
-            } else {
-                collection.frames[i].data = nullptr;
-            }
-            
-            // Update progress
-            {
-                std::lock_guard<std::mutex> lock(progressMutex);
-                loadedCount++;
-                // Always show progress (even in quiet mode), just suppress verbose headers
-                std::cout << "\rLoading: " << loadedCount << "/" << files.size() << std::flush;
-                
-                if (progressCallback) {
-                    progressCallback(loadedCount, (int)files.size());
-                }
-            }
-        }
-    };
-    
-    // Create and start threads
-    std::vector<std::thread> threads;
-    size_t filesPerThread = (files.size() + numThreads - 1) / numThreads;
-    
-    for (int t = 0; t < numThreads; t++) {
-        size_t startIdx = t * filesPerThread;
-        size_t endIdx = std::min(startIdx + filesPerThread, files.size());
-        if (startIdx < files.size()) {
-            threads.emplace_back(loadWorker, startIdx, endIdx);
+        std::cout << "Loading " << files.size() << " images with " << SharedThreadPool().size() << " threads";
+        if (ioThreads > 0) {
+            std::cout << " (" << ioThreads << " read-ahead)";
         }
+        std::cout << "..." << std::endl;
     }
     
-    // Wait for all threads
-    for (auto& thread : threads) {
-        thread.join();
-    }
+    int firstWidth = 0, firstHeight = 0;
+    LoadPipelineStats stats;
+    bool completed = LoadFrameList(files, shrinkFactor, ioThreads, rgbOutput, flipVertical, format,
+                                   compression, keyframeInterval, collection.frames, firstWidth, firstHeight,
+        [&](int current, int total) {
+            // Always show progress (even in quiet mode), just suppress verbose headers
+            std::cout << "\rLoading: " << current << "/" << total << std::flush;
+            return progressCallback ? progressCallback(current, total) : true;
+        }, &stats);
     if (!quietMode) {
         std::cout << std::endl;
+        PrintLoadPipelineStats(stats);
     }
     
     // Check if interrupted
-    if (g_interrupted.load()) {
+    if (!completed) {
         std::cout << "\nLoading interrupted by user (Ctrl+C)" << std::endl;
         collection.cleanup();
         return false;
     }
     
-    // Remove failed loads
-    collection.frames.erase(
-        std::remove_if(collection.frames.begin(), collection.frames.end(),
-            [](const ImageFrame& f) { return f.data == nullptr; }),
-        collection.frames.end()
-    );
-    
     if (collection.frames.empty()) {
         std::cerr << "No images could be loaded" << std::endl;
         return false;
     }
     
-    // Sort by index
-    std::sort(collection.frames.begin(), collection.frames.end(),
-        [](const ImageFrame& a, const ImageFrame& b) { return a.index < b.index; });
-    
     collection.imageWidth = firstWidth;
     collection.imageHeight = firstHeight;
     collection.originalImageWidth = firstWidth * shrinkFactor;
@@ -247,14 +698,26 @@ bool LoadImagesCommon(
     
     // Print memory stats
     if (!quietMode) {
-        size_t bytesPerImage = (size_t)firstWidth * firstHeight * 3;
-        size_t totalBytes = bytesPerImage * collection.frames.size();
+        size_t bytesPerImage = collection.frameBytes();
+        size_t rawBytes = bytesPerImage * collection.frames.size();
+        size_t totalBytes = 0;
+        for (const auto& frame : collection.frames) {
+            totalBytes += FrameBufferFootprint(StoredFrameBytes(frame, bytesPerImage));
+        }
         
         std::cout << "\nMemory usage:" << std::endl;
         std::cout << "  Shrink factor: " << shrinkFactor << std::endl;
-        std::cout << "  Preview: " << firstWidth << " x " << firstHeight << std::endl;
+        std::cout << "  Preview: " << firstWidth << " x " << firstHeight << " "
+                  << PixelFormatName(format) << std::endl;
         std::cout << "  Original: " << collection.originalImageWidth << " x " << collection.originalImageHeight << std::endl;
         
+        Histogram histogram = SequenceHistogram(FrameSpan(collection.frames));
+        if (histogram.samples > 0) {
+            std::cout << "  Sample range: " << histogram.minValue << " - " << histogram.maxValue
+                      << " (0.5% - 99.5%: " << (unsigned)histogram.percentile(0.005)
+                      << " - " << (unsigned)histogram.percentile(0.995) << ")" << std::endl;
+        }
+        
         if (totalBytes < 1024 * 1024) {
             std::cout << "  Total RAM: " << (totalBytes / 1024.0) << " KB" << std::endl;
         } else if (totalBytes < 1024 * 1024 * 1024) {
@@ -262,9 +725,17 @@ bool LoadImagesCommon(
         } else {
             std::cout << "  Total RAM: " << (totalBytes / (1024.0 * 1024.0 * 1024.0)) << " GB" << std::endl;
         }
+        if (compression != FrameCompression::Off && totalBytes > 0) {
+            size_t packed = std::count_if(collection.frames.begin(), collection.frames.end(),
+                                          [](const ImageFrame& frame) { return frame.packedBytes > 0; });
+            std::cout << "  Compression: " << FrameCompressionName(compression) << ", keyframe every "
+                      << keyframeInterval << ", " << std::setprecision(3) << ((double)rawBytes / totalBytes)
+                      << "x (" << packed << " of " << collection.frames.size() << " frames packed)"
+                      << std::setprecision(6) << std::endl;
+        }
         
         std::cout << "\nLoaded " << collection.frames.size() << " images for preview" << std::endl;
-        std::cout << "Export will use all " << collection.allFilePaths.size() << " files at full resolution" << std::endl;
+        std::cout << "Export will use all " << collection.allFiles.size() << " files at full resolution" << std::endl;
     }
     
     return true;
@@ -14,32 +14,124 @@
 extern std::atomic<bool> g_interrupted;
 
 // Extract the numeric index from filename like "e_png_yx_0.5_000100.png"
-// Matches pattern *_<number>.png
-int ExtractIndex(const std::string& filename);
+// Matches pattern *_<number>.png (see ParseFrameIndex)
+int64_t ExtractIndex(const std::string& filename);
 
-// Load and shrink a single image
-// Returns RGB data (for Linux/SDL2) when rgbOutput=true, BGR (for Windows) when false
+// Load a whole image as RGB (file read in one go, then decoded from memory with the
+// built-in PNG decoder, or stb_image for files it does not handle).
+// Returns nullptr on failure; free the result with FreeImage.
+unsigned char* LoadImageFile(const std::string& filename, int& width, int& height);
+void FreeImage(unsigned char* data);
+
+// Decode an in-memory PNG and shrink it (see LoadAndShrinkImage); filename is only
+// used in error messages
+unsigned char* DecodeAndShrinkImage(const unsigned char* contents, size_t size, const std::string& filename,
+                                    int shrinkFactor, int& outWidth, int& outHeight,
+                                    bool rgbOutput = true, bool flipVertical = false,
+                                    PixelFormat format = PixelFormat::RGB8);
+
+// Load and shrink a single image to `format`
+// RGB8 is RGB (for Linux/SDL2) when rgbOutput=true, BGR (for Windows) when false
 unsigned char* LoadAndShrinkImage(const std::string& filename, int shrinkFactor, 
                                    int& outWidth, int& outHeight,
-                                   bool rgbOutput = true, bool flipVertical = false);
+                                   bool rgbOutput = true, bool flipVertical = false,
+                                   PixelFormat format = PixelFormat::RGB8);
+
+// Preview format for a sequence, from its first file: Gray8/Gray16 for 8/16-bit gray
+// (or gray+alpha) PNGs, RGB8 for everything else
+PixelFormat ProbePixelFormat(const std::string& probeFilePath);
 
 // Auto-calculate shrink factor based on image and window dimensions
 int AutoCalculateShrinkFactor(const std::string& probeFilePath, int windowWidth, int windowHeight);
 
+// Preview settings that fit a memory budget (see PlanPreviewMemory)
+struct PreviewMemoryPlan {
+    int shrinkFactor = 1;
+    int nthFrame = 1;
+    FrameCompression compression = FrameCompression::Off;
+    double compressionRatio = 1.0;  // Estimated from the first frames (1 = uncompressed)
+    size_t frames = 0;              // Previews that will be loaded
+    size_t bytes = 0;               // Estimated preview RAM
+    size_t budgetFrames = 0;        // Previews the budget holds, if a stride was needed
+    bool fits = false;              // false if not even the first and last preview fit
+};
+
+// Choose shrink factor, stride and compression so the previews of `files` fit in
+// budgetBytes, from the first file's size and the file count. A shrinkFactor > 0 is
+// kept as given, nthFrame is the smallest stride used, and compression is only
+// switched on (to compressionMode, estimated by packing the first frames) if
+// allowCompression. Compression is tried first, then shrinking down to about the
+// window size, then a larger stride.
+PreviewMemoryPlan PlanPreviewMemory(const FileTable& files, PixelFormat format, size_t budgetBytes,
+                                    int shrinkFactor, int nthFrame, int windowWidth, int windowHeight,
+                                    bool allowCompression, FrameCompression compressionMode,
+                                    int keyframeInterval);
+void PrintPreviewMemoryPlan(const PreviewMemoryPlan& plan, size_t budgetBytes);
+
 // Progress callback: (current, total) -> should_continue
 using ProgressCallback = std::function<bool(int current, int total)>;
 
+// Work done by one stage of the loading pipeline
+struct LoadStageStats {
+    int threads = 0;            // 0 for reads done by the decode threads
+    size_t files = 0;
+    size_t bytes = 0;           // Read: compressed bytes; decode/store: preview bytes
+    double busySeconds = 0.0;   // Summed over the stage's threads
+};
+
+// Per-stage throughput and queue occupancy of one LoadFrameList call
+struct LoadPipelineStats {
+    LoadStageStats read;
+    LoadStageStats decode;
+    LoadStageStats store;
+    double seconds = 0.0;       // Wall time
+    size_t queueCapacity = 0;   // Of each queue
+    double readQueueMean = 0.0; // Compressed files waiting for a decoder
+    size_t readQueueMax = 0;
+    double previewQueueMean = 0.0;  // Previews waiting to be stored
+    size_t previewQueueMax = 0;
+};
+
+void PrintLoadPipelineStats(const LoadPipelineStats& stats);
+
+// Load and shrink a list of files into frames in `format` (sorted by index, failed
+// loads dropped), packed with `compression` in runs of keyframeInterval frames (see
+// frame_store.h); width/height receive the preview dimensions. ioThreads threads read
+// whole files into a bounded queue for decode tasks on the shared thread pool, which
+// must be running and whose size caps decoding (0 ioThreads = the tasks read for
+// themselves); previews are stored and progress is reported on the calling thread.
+// stats, if given, receives the per-stage throughput.
+// Returns false if interrupted or cancelled by the callback, with frames left empty.
+bool LoadFrameList(
+    const std::vector<std::string>& files,
+    int shrinkFactor,
+    int ioThreads,
+    bool rgbOutput,
+    bool flipVertical,
+    PixelFormat format,
+    FrameCompression compression,
+    int keyframeInterval,
+    std::vector<ImageFrame>& frames,
+    int& width,
+    int& height,
+    ProgressCallback progressCallback = nullptr,
+    LoadPipelineStats* stats = nullptr
+);
+
 // Load images from a folder - platform independent parts
 // Platform-specific code should handle file enumeration and pass file list here
 bool LoadImagesCommon(
     ImageCollection& collection,
     const std::vector<std::string>& files,          // Already sorted file paths
-    const std::vector<std::string>& allFilePaths,   // All files for export
+    const FileTable& allFiles,                      // All files for export
     const std::string& folder,
     int shrinkFactor,
-    int numThreads,
+    int ioThreads,          // File read threads (0 = decoders read)
     bool rgbOutput,         // true for Linux/SDL2, false for Windows
     bool flipVertical,      // true for Windows GDI (bottom-up DIB)
+    PixelFormat format,     // Preview format (see ProbePixelFormat)
+    FrameCompression compression,   // Packed previews (see frame_store.h)
+    int keyframeInterval,           // Frames per keyframe when compressing
     ProgressCallback progressCallback = nullptr,
     bool quietMode = false  // Suppress detailed output (for 3D batch loading)
 );
@@ -119,4 +119,46 @@ inline RenderParams CalculateRenderParams(const ViewState& view, const AppSettin
     return params;
 }
 
+// Mapping from export-frame pixels to image coordinates
+struct ExportMapping {
+    double centerX, centerY;    // Image point shown at the centre of the export frame
+    double scaleX, scaleY;      // Export pixels per image pixel
+};
+
+// Map the region visible in the preview window onto an outW x outH export frame.
+// imageWidth/imageHeight and the view must be in the same (export source) coordinates.
+inline ExportMapping CalculateExportMapping(const ViewState& view, const AppSettings& settings,
+                                            int imageWidth, int imageHeight,
+                                            int outW, int outH) {
+    ExportMapping mapping;
+
+    double fitScale = GetFitScale(settings.windowWidth, settings.windowHeight, imageWidth, imageHeight);
+    double currentScale = fitScale * view.zoomLevel;
+
+    // Region of the image visible in the preview window
+    double visibleWidth = settings.windowWidth / currentScale;
+    double visibleHeight = settings.windowHeight / currentScale;
+
+    mapping.centerX = imageWidth / 2.0 + view.panX;
+    mapping.centerY = imageHeight / 2.0 + view.panY;
+
+    double scaleX = outW / visibleWidth;
+    double scaleY = outH / visibleHeight;
+
+    switch (settings.exportAspect) {
+        case ExportAspect::Fit:
+            mapping.scaleX = mapping.scaleY = std::min(scaleX, scaleY);
+            break;
+        case ExportAspect::Fill:
+            mapping.scaleX = mapping.scaleY = std::max(scaleX, scaleY);
+            break;
+        case ExportAspect::Stretch:
+            mapping.scaleX = scaleX;
+            mapping.scaleY = scaleY;
+            break;
+    }
+
+    return mapping;
+}
+
 #endif // MATH_UTILS_H
@@ -0,0 +1,454 @@
+// PNG decoding implementation
+
+#include "png_decoder.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <new>
+
+#if defined(PNG_DECODER_LIBDEFLATE)
+#include <libdeflate.h>
+#elif !defined(PNG_DECODER_STB)
+#include <zlib.h>
+#endif
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(PNG_DECODER_NO_SIMD)
+#include <emmintrin.h>
+#define PNG_UNFILTER_SSE2
+#endif
+
+const char* PngDecoderName() {
+#if defined(PNG_DECODER_LIBDEFLATE)
+    return "libdeflate";
+#elif defined(PNG_DECODER_STB)
+    return "stb_image";
+#else
+    return "zlib";
+#endif
+}
+
+#ifdef PNG_DECODER_STB
+
+unsigned char* DecodePNG(const unsigned char*, size_t, int&, int&) {
+    return nullptr;
+}
+
+unsigned char* DecodePNGShrunk(const unsigned char*, size_t, int, PixelFormat, bool, bool, int&, int&) {
+    return nullptr;
+}
+
+#else
+
+static uint32_t GetU32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Inflate a zlib stream into exactly outSize bytes
+static bool Inflate(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize) {
+#if defined(PNG_DECODER_LIBDEFLATE)
+    // One decompressor per thread, reused across files
+    struct Deleter {
+        void operator()(libdeflate_decompressor* d) const { libdeflate_free_decompressor(d); }
+    };
+    thread_local std::unique_ptr<libdeflate_decompressor, Deleter> decompressor(libdeflate_alloc_decompressor());
+    if (!decompressor) return false;
+
+    size_t actual = 0;
+    return libdeflate_zlib_decompress(decompressor.get(), in, inSize, out, outSize, &actual) == LIBDEFLATE_SUCCESS
+        && actual == outSize;
+#else
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) return false;
+
+    // avail_in/avail_out are 32-bit, so feed large buffers in pieces
+    const size_t maxChunk = 1u << 30;
+    size_t inDone = 0, outDone = 0;
+    int result = Z_OK;
+    while (result == Z_OK) {
+        if (stream.avail_in == 0 && inDone < inSize) {
+            stream.next_in = const_cast<unsigned char*>(in + inDone);
+            stream.avail_in = (uInt)std::min(inSize - inDone, maxChunk);
+            inDone += stream.avail_in;
+        }
+        if (stream.avail_out == 0 && outDone < outSize) {
+            stream.next_out = out + outDone;
+            stream.avail_out = (uInt)std::min(outSize - outDone, maxChunk);
+            outDone += stream.avail_out;
+        }
+        result = inflate(&stream, Z_NO_FLUSH);
+        if (result == Z_BUF_ERROR && (stream.avail_out == 0 && outDone == outSize)) {
+            break;  // Output complete; anything after the image data is ignored
+        }
+    }
+    size_t produced = outDone - stream.avail_out;
+    inflateEnd(&stream);
+    return produced == outSize;
+#endif
+}
+
+static inline unsigned char Paeth(int a, int b, int c) {
+    int pa = std::abs(b - c);           // |p - a| with p = a + b - c
+    int pb = std::abs(a - c);
+    int pc = std::abs(a + b - 2 * c);
+    int nearest = (pb <= pc) ? b : c;
+    return (unsigned char)((pa <= pb && pa <= pc) ? a : nearest);
+}
+
+// Extra bytes after each row buffer, so whole 4- and 16-byte loads and stores may run
+// past the end of a row
+static const size_t kRowPadding = 16;
+
+// Deflate cannot expand data by more than about 1032:1, so an IHDR claiming more
+// pixel data than that of its IDAT bytes is corrupt
+static const size_t kMaxInflateRatio = 1032;
+
+// Reverse one row's filter: src is the filtered row, prior the previous unfiltered row
+// (zeros for the first), dst receives the unfiltered row. Instantiated per pixel size
+// so the inner loops have a constant stride.
+template <int bpp>
+static bool UnfilterRowScalar(int filter, unsigned char* dst, const unsigned char* src,
+                              const unsigned char* prior, size_t length) {
+    switch (filter) {
+        case 0:
+            std::memcpy(dst, src, length);
+            break;
+        case 1:
+            for (int i = 0; i < bpp; ++i) dst[i] = src[i];
+            for (size_t i = bpp; i < length; ++i) dst[i] = src[i] + dst[i - bpp];
+            break;
+        case 2:
+            for (size_t i = 0; i < length; ++i) dst[i] = src[i] + prior[i];
+            break;
+        case 3:
+            for (int i = 0; i < bpp; ++i) dst[i] = src[i] + (prior[i] >> 1);
+            for (size_t i = bpp; i < length; ++i) dst[i] = src[i] + ((dst[i - bpp] + prior[i]) >> 1);
+            break;
+        case 4:
+            for (int i = 0; i < bpp; ++i) dst[i] = src[i] + prior[i];
+            for (size_t i = bpp; i < length; ++i) dst[i] = src[i] + Paeth(dst[i - bpp], prior[i], prior[i - bpp]);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+#ifdef PNG_UNFILTER_SSE2
+
+// SSE2 versions for 3- and 4-byte pixels. Sub, Avg and Paeth depend on the pixel to
+// the left, so they step one pixel at a time with all channels in one register;
+// Up has no such dependency and runs 16 bytes at a time. Every pixel is moved as 4
+// bytes: for 3-byte pixels the extra lane is ignored, and the byte it writes past the
+// pixel is overwritten by the next one (or lands in the row padding).
+static inline __m128i LoadPixel(const unsigned char* p) {
+    int32_t v;
+    std::memcpy(&v, p, 4);
+    return _mm_cvtsi32_si128(v);
+}
+
+static inline void StorePixel(unsigned char* p, __m128i v) {
+    int32_t bits = _mm_cvtsi128_si32(v);
+    std::memcpy(p, &bits, 4);
+}
+
+static inline __m128i Select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline __m128i Abs16(__m128i x) {
+    return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static void UnfilterUpSse2(unsigned char* dst, const unsigned char* src, const unsigned char* prior,
+                           size_t length) {
+    for (size_t i = 0; i < length; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(prior + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(x, b));
+    }
+}
+
+template <int bpp>
+static void UnfilterSubSse2(unsigned char* dst, const unsigned char* src, size_t length) {
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i < length; i += bpp) {
+        a = _mm_add_epi8(LoadPixel(src + i), a);
+        StorePixel(dst + i, a);
+    }
+}
+
+template <int bpp>
+static void UnfilterAvgSse2(unsigned char* dst, const unsigned char* src, const unsigned char* prior,
+                            size_t length) {
+    const __m128i one = _mm_set1_epi8(1);
+    __m128i a = _mm_setzero_si128();
+    for (size_t i = 0; i < length; i += bpp) {
+        __m128i b = LoadPixel(prior + i);
+        // _mm_avg_epu8 rounds up; PNG's average rounds down
+        __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(LoadPixel(src + i), avg);
+        StorePixel(dst + i, a);
+    }
+}
+
+template <int bpp>
+static void UnfilterPaethSse2(unsigned char* dst, const unsigned char* src, const unsigned char* prior,
+                              size_t length) {
+    // Predictor arithmetic in 16 bits: a = left, b = above, c = above-left
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero, c = zero;
+    for (size_t i = 0; i < length; i += bpp) {
+        __m128i b = _mm_unpacklo_epi8(LoadPixel(prior + i), zero);
+        __m128i pa = _mm_sub_epi16(b, c);
+        __m128i pb = _mm_sub_epi16(a, c);
+        __m128i pc = Abs16(_mm_add_epi16(pa, pb));
+        pa = Abs16(pa);
+        pb = Abs16(pb);
+        __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+        __m128i nearest = Select(_mm_cmpeq_epi16(smallest, pa), a,
+                                 Select(_mm_cmpeq_epi16(smallest, pb), b, c));
+        __m128i d = _mm_add_epi8(LoadPixel(src + i), _mm_packus_epi16(nearest, nearest));
+        StorePixel(dst + i, d);
+        a = _mm_unpacklo_epi8(d, zero);
+        c = b;
+    }
+}
+
+template <int bpp>
+static bool UnfilterRowSse2(int filter, unsigned char* dst, const unsigned char* src,
+                            const unsigned char* prior, size_t length) {
+    switch (filter) {
+        case 0:  std::memcpy(dst, src, length); break;
+        case 1:  UnfilterSubSse2<bpp>(dst, src, length); break;
+        case 2:  UnfilterUpSse2(dst, src, prior, length); break;
+        case 3:  UnfilterAvgSse2<bpp>(dst, src, prior, length); break;
+        case 4:  UnfilterPaethSse2<bpp>(dst, src, prior, length); break;
+        default: return false;
+    }
+    return true;
+}
+
+#endif
+
+static bool UnfilterRow(int filter, unsigned char* dst, const unsigned char* src,
+                        const unsigned char* prior, size_t length, int bpp) {
+#ifdef PNG_UNFILTER_SSE2
+    if (filter == 2) {
+        UnfilterUpSse2(dst, src, prior, length);
+        return true;
+    }
+    switch (bpp) {
+        case 1:  return UnfilterRowScalar<1>(filter, dst, src, prior, length);
+        case 2:  return UnfilterRowScalar<2>(filter, dst, src, prior, length);
+        case 3:  return UnfilterRowSse2<3>(filter, dst, src, prior, length);
+        default: return UnfilterRowSse2<4>(filter, dst, src, prior, length);
+    }
+#else
+    switch (bpp) {
+        case 1:  return UnfilterRowScalar<1>(filter, dst, src, prior, length);
+        case 2:  return UnfilterRowScalar<2>(filter, dst, src, prior, length);
+        case 3:  return UnfilterRowScalar<3>(filter, dst, src, prior, length);
+        default: return UnfilterRowScalar<4>(filter, dst, src, prior, length);
+    }
+#endif
+}
+
+struct PngImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    int channels = 0;
+    int bytesPerSample = 1;                 // 2 for 16-bit gray
+    const unsigned char* idat = nullptr;
+    size_t idatSize = 0;
+    std::vector<unsigned char> joined;      // IDAT data when split over several chunks
+};
+
+// Read the chunks: IHDR first, then the IDAT data (concatenated if split)
+static bool ParsePng(const unsigned char* data, size_t size, PngImage& png) {
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    if (size < 8 + 25 || std::memcmp(data, signature, 8) != 0) return false;
+
+    size_t pos = 8;
+    bool sawHeader = false;
+    while (pos + 12 <= size) {
+        uint32_t length = GetU32(data + pos);
+        const unsigned char* type = data + pos + 4;
+        const unsigned char* body = data + pos + 8;
+        if (length > size - pos - 12) return false;
+
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (length < 13) return false;
+            png.width = GetU32(body);
+            png.height = GetU32(body + 4);
+            int bitDepth = body[8], colorType = body[9], interlace = body[12];
+            // Non-interlaced 8-bit gray / RGB / gray+alpha / RGBA and 16-bit gray /
+            // gray+alpha only
+            if (interlace != 0) return false;
+            switch (colorType) {
+                case 0: png.channels = 1; break;
+                case 2: png.channels = 3; break;
+                case 4: png.channels = 2; break;
+                case 6: png.channels = 4; break;
+                default: return false;
+            }
+            if (bitDepth == 16 && png.channels <= 2) {
+                png.bytesPerSample = 2;
+            } else if (bitDepth != 8) {
+                return false;
+            }
+            sawHeader = true;
+        } else if (std::memcmp(type, "PLTE", 4) == 0 || std::memcmp(type, "tRNS", 4) == 0) {
+            return false;       // Palette / transparency key: left to stb_image
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            if (!png.idat) {
+                png.idat = body;
+                png.idatSize = length;
+            } else {
+                if (png.joined.empty()) png.joined.assign(png.idat, png.idat + png.idatSize);
+                png.joined.insert(png.joined.end(), body, body + length);
+            }
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        pos += 12 + (size_t)length;
+    }
+    if (!sawHeader || !png.idat || png.width == 0 || png.height == 0 ||
+        png.width > (1u << 24) || png.height > (1u << 24)) {
+        return false;
+    }
+    if (!png.joined.empty()) {
+        png.idat = png.joined.data();
+        png.idatSize = png.joined.size();
+    }
+    size_t rawSize = ((size_t)png.width * png.channels * png.bytesPerSample + 1) * png.height;
+    return rawSize / kMaxInflateRatio <= png.idatSize;
+}
+
+// Copy every step-th pixel of an unfiltered row in the output format. RGB drops alpha
+// and replicates gray; 16-bit samples are narrowed to their high byte and 8-bit
+// samples widened by 257, both as stb_image does.
+static void ConvertRow(const unsigned char* row, const PngImage& png, int step, int count,
+                       PixelFormat format, bool rgbOutput, unsigned char* out) {
+    size_t pixelBytes = (size_t)png.channels * png.bytesPerSample;
+    if (step == 1 && png.bytesPerSample == 1 &&
+        ((format == PixelFormat::RGB8 && png.channels == 3 && rgbOutput) ||
+         (format == PixelFormat::Gray8 && png.channels == 1))) {
+        std::memcpy(out, row, (size_t)count * pixelBytes);
+        return;
+    }
+    size_t srcStep = (size_t)step * pixelBytes;
+    switch (format) {
+        case PixelFormat::Gray8:
+            for (int x = 0; x < count; ++x, row += srcStep) {
+                out[x] = row[0];
+            }
+            break;
+        case PixelFormat::Gray16: {
+            uint16_t* out16 = (uint16_t*)out;
+            for (int x = 0; x < count; ++x, row += srcStep) {
+                out16[x] = png.bytesPerSample == 2 ? (uint16_t)((row[0] << 8) | row[1]) : (uint16_t)(row[0] * 257);
+            }
+            break;
+        }
+        default: {
+            int r = rgbOutput ? 0 : 2, b = rgbOutput ? 2 : 0;
+            for (int x = 0; x < count; ++x, row += srcStep, out += 3) {
+                if (png.channels >= 3) {
+                    out[r] = row[0];
+                    out[1] = row[1];
+                    out[b] = row[2];
+                } else {
+                    out[0] = out[1] = out[2] = row[0];
+                }
+            }
+            break;
+        }
+    }
+}
+
+// Inflate and unfilter all rows; every shrink-th row is converted into out (flipped if
+// asked). Rows in between must still be unfiltered as the next row depends on them.
+static bool DecodeRows(const PngImage& png, int shrink, PixelFormat format, bool rgbOutput, bool flipVertical,
+                       unsigned char* out) {
+    int pixelBytes = png.channels * png.bytesPerSample;
+    size_t stride = (size_t)png.width * pixelBytes;
+    size_t rawSize = (stride + 1) * png.height;
+    thread_local std::vector<unsigned char> raw;
+    try {
+        raw.resize(rawSize + kRowPadding);
+    } catch (const std::bad_alloc&) {
+        return false;           // Left to stb_image, or the frame is skipped
+    }
+    if (!Inflate(png.idat, png.idatSize, raw.data(), rawSize)) return false;
+
+    // Rows are unfiltered into two alternating buffers, so the inflated data is only
+    // read and the previous row is always at hand
+    size_t rowBytes = stride + kRowPadding;
+    thread_local std::vector<unsigned char> rows;
+    rows.assign(2 * rowBytes, 0);
+    unsigned char* row = rows.data();
+    unsigned char* prior = rows.data() + rowBytes;
+
+    int outWidth = (int)png.width / shrink;
+    int outHeight = (int)png.height / shrink;
+    size_t outStride = (size_t)outWidth * BytesPerPixel(format);
+    uint32_t lastRow = (uint32_t)outHeight * shrink;     // Rows below are never kept
+    for (uint32_t y = 0; y < lastRow; ++y) {
+        const unsigned char* line = raw.data() + y * (stride + 1);
+        if (!UnfilterRow(line[0], row, line + 1, prior, stride, pixelBytes)) return false;
+
+        if (y % shrink == 0) {
+            int outY = (int)(y / shrink);
+            if (flipVertical) outY = outHeight - 1 - outY;
+            ConvertRow(row, png, shrink, outWidth, format, rgbOutput, out + (size_t)outY * outStride);
+        }
+        std::swap(row, prior);
+    }
+    return true;
+}
+
+unsigned char* DecodePNG(const unsigned char* data, size_t size, int& width, int& height) {
+    PngImage png;
+    if (!ParsePng(data, size, png)) return nullptr;
+
+    unsigned char* rgb = (unsigned char*)std::malloc((size_t)png.width * png.height * 3);
+    if (!rgb) return nullptr;
+    if (!DecodeRows(png, 1, PixelFormat::RGB8, true, false, rgb)) {
+        std::free(rgb);
+        return nullptr;
+    }
+    width = (int)png.width;
+    height = (int)png.height;
+    return rgb;
+}
+
+unsigned char* DecodePNGShrunk(const unsigned char* data, size_t size, int shrinkFactor, PixelFormat format,
+                               bool rgbOutput, bool flipVertical, int& outWidth, int& outHeight) {
+    PngImage png;
+    if (shrinkFactor < 1 || !ParsePng(data, size, png)) return nullptr;
+    if (format != PixelFormat::RGB8 && png.channels >= 3) return nullptr;  // Luma conversion: stb_image
+
+    int newWidth = (int)png.width / shrinkFactor;
+    int newHeight = (int)png.height / shrinkFactor;
+    if (newWidth == 0 || newHeight == 0) return nullptr;
+
+    unsigned char* output = nullptr;
+    try {
+        output = AllocFrameBuffer((size_t)newWidth * newHeight * BytesPerPixel(format));
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+    if (!DecodeRows(png, shrinkFactor, format, rgbOutput, flipVertical, output)) {
+        FreeFrameBuffer(output);
+        return nullptr;
+    }
+    outWidth = newWidth;
+    outHeight = newHeight;
+    return output;
+}
+
+#endif
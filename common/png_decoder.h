@@ -0,0 +1,37 @@
+// PNG decoding for PNG Image Viewer
+// A decoder for the common case of simulation output (non-interlaced 8-bit gray,
+// gray+alpha, RGB or RGBA, and 16-bit gray or gray+alpha) that inflates with zlib or
+// libdeflate instead of stb_image's built-in inflate, and unfilters 3- and 4-byte
+// pixels with SSE2 where available. Other PNGs are left to stb_image.
+//
+// The backend is chosen at build time (see DECODER in linux/Makefile):
+//   PNG_DECODER_LIBDEFLATE  libdeflate
+//   PNG_DECODER_STB         none, stb_image decodes everything
+//   (default)               zlib (or zlib-ng in zlib-compat mode)
+// PNG_DECODER_NO_SIMD keeps the scalar unfilter loops (for comparison).
+
+#ifndef PNG_DECODER_H
+#define PNG_DECODER_H
+
+#include "frame_types.h"
+#include <cstddef>
+
+// Name of the compiled-in backend ("zlib", "libdeflate" or "stb_image")
+const char* PngDecoderName();
+
+// Decode an in-memory PNG to RGB8 (alpha dropped, gray replicated, as stb_image does
+// for 3 requested channels). The result is allocated with malloc.
+// Returns nullptr if the file is not supported by this decoder or is corrupt;
+// the caller then falls back to stb_image.
+unsigned char* DecodePNG(const unsigned char* data, size_t size, int& width, int& height);
+
+// Decode and shrink by taking every shrinkFactor-th pixel of every shrinkFactor-th row,
+// as DecodeAndShrinkImage does, without building the full-size image: skipped rows are
+// unfiltered (the next row depends on them) but never converted.
+// Returns (width/shrink) x (height/shrink) pixels in `format` (RGB8 as RGB or BGR)
+// allocated with AllocFrameBuffer, or nullptr as DecodePNG does. Gray formats are only
+// produced from gray files; colour files are left to stb_image's luma conversion.
+unsigned char* DecodePNGShrunk(const unsigned char* data, size_t size, int shrinkFactor, PixelFormat format,
+                               bool rgbOutput, bool flipVertical, int& outWidth, int& outHeight);
+
+#endif // PNG_DECODER_H
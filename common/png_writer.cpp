@@ -0,0 +1,90 @@
+// PNG writing implementation
+// Rows are stored with the "Up" filter, which suits smooth simulation output
+
+#include "png_writer.h"
+#include <zlib.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <iostream>
+
+static void PutU32(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static bool WriteChunk(FILE* file, const char* type, const unsigned char* data, size_t length) {
+    unsigned char header[8];
+    PutU32(header, (unsigned int)length);
+    std::memcpy(header + 4, type, 4);
+
+    uLong crc = crc32(0L, header + 4, 4);
+    if (length > 0) {
+        crc = crc32(crc, data, (uInt)length);
+    }
+    unsigned char trailer[4];
+    PutU32(trailer, (unsigned int)crc);
+
+    return std::fwrite(header, 1, 8, file) == 8
+        && (length == 0 || std::fwrite(data, 1, length, file) == length)
+        && std::fwrite(trailer, 1, 4, file) == 4;
+}
+
+bool WritePNG(const std::string& filename, const unsigned char* rgb,
+              int width, int height, int compressionLevel) {
+    size_t stride = static_cast<size_t>(width) * 3;
+
+    // Filtered scanlines: one filter-type byte per row followed by the row
+    std::vector<unsigned char> filtered((stride + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        unsigned char* dst = &filtered[(stride + 1) * y];
+        const unsigned char* row = rgb + stride * y;
+        if (y == 0) {
+            dst[0] = 0;  // None
+            std::memcpy(dst + 1, row, stride);
+        } else {
+            dst[0] = 2;  // Up
+            const unsigned char* prev = row - stride;
+            for (size_t i = 0; i < stride; ++i) {
+                dst[1 + i] = (unsigned char)(row[i] - prev[i]);
+            }
+        }
+    }
+
+    uLongf compressedSize = compressBound((uLong)filtered.size());
+    std::vector<unsigned char> compressed(compressedSize);
+    if (compress2(compressed.data(), &compressedSize, filtered.data(), (uLong)filtered.size(),
+                  compressionLevel) != Z_OK) {
+        std::cerr << "PNG compression failed: " << filename << std::endl;
+        return false;
+    }
+
+    FILE* file = std::fopen(filename.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Could not write: " << filename << std::endl;
+        return false;
+    }
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    unsigned char ihdr[13];
+    PutU32(ihdr, (unsigned int)width);
+    PutU32(ihdr + 4, (unsigned int)height);
+    ihdr[8] = 8;    // Bit depth
+    ihdr[9] = 2;    // Colour type: RGB
+    ihdr[10] = 0;   // Compression
+    ihdr[11] = 0;   // Filter method
+    ihdr[12] = 0;   // No interlace
+
+    bool ok = std::fwrite(signature, 1, 8, file) == 8
+        && WriteChunk(file, "IHDR", ihdr, sizeof(ihdr))
+        && WriteChunk(file, "IDAT", compressed.data(), compressedSize)
+        && WriteChunk(file, "IEND", nullptr, 0);
+
+    if (std::fclose(file) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "Error writing: " << filename << std::endl;
+    }
+    return ok;
+}
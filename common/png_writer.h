@@ -0,0 +1,14 @@
+// PNG writing for PNG Image Viewer
+// Minimal 8-bit RGB PNG encoder on top of zlib (used for PNG sequence export)
+
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <string>
+
+// Write an 8-bit RGB image (top-down, tightly packed) as a PNG file.
+// compressionLevel is the zlib level (1 = fastest, 9 = smallest).
+bool WritePNG(const std::string& filename, const unsigned char* rgb,
+              int width, int height, int compressionLevel = 1);
+
+#endif // PNG_WRITER_H
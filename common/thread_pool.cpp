@@ -0,0 +1,99 @@
+// Thread pool implementation
+
+#include "thread_pool.h"
+#include "cpu_topology.h"
+#include <algorithm>
+
+void ThreadPool::start(int numThreads) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_threads.empty()) return;
+
+    m_stopping = false;
+    for (int i = 0; i < std::max(1, numThreads); ++i) {
+        m_threads.emplace_back([this, i]() {
+            PinThisThread(i);
+            workerLoop();
+        });
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task, TaskPriority priority) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks[(int)priority].push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+void ThreadPool::shutdown() {
+    // Dropped outside the lock: a dropped TaskGroup task reports itself finished
+    std::deque<std::function<void()>> dropped[kPriorities];
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        for (int p = 0; p < kPriorities; ++p) {
+            dropped[p].swap(m_tasks[p]);
+        }
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            auto next = [this]() {
+                for (auto& queue : m_tasks) {
+                    if (!queue.empty()) return &queue;
+                }
+                return (std::deque<std::function<void()>>*)nullptr;
+            };
+            m_wake.wait(lock, [&]() { return m_stopping || next() != nullptr; });
+            if (m_stopping) return;
+            auto* queue = next();
+            task = std::move(queue->front());
+            queue->pop_front();
+        }
+        task();
+    }
+}
+
+ThreadPool& SharedThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void TaskGroup::run(std::function<void()> task, TaskPriority priority) {
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->pending++;
+    }
+
+    // The token's deleter runs once the task has run, or when a dropped task is destroyed
+    std::shared_ptr<State> state = m_state;
+    std::shared_ptr<void> token(nullptr, [state](void*) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (--state->pending == 0) {
+            state->finished.notify_all();
+        }
+    });
+    m_pool.submit([task = std::move(task), token]() mutable {
+        task();
+        token.reset();
+    }, priority);
+}
+
+void TaskGroup::wait() {
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    m_state->finished.wait(lock, [this]() { return m_state->pending == 0; });
+}
+
+size_t TaskGroup::pending() const {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->pending;
+}
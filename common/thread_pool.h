@@ -0,0 +1,88 @@
+// Thread pool for PNG Image Viewer
+// A fixed set of worker threads that stay alive and run queued tasks, highest
+// priority first and in order within a priority; workers are pinned to the first
+// CPUs when thread pinning is on (see cpu_topology.h). Loading, the 3D z-slice
+// loader, exports and the 3D views all share one pool (SharedThreadPool), so no
+// threads are created per call and background work yields to interactive work
+// between tasks.
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <cstddef>
+
+// Which queued task a free worker takes first
+enum class TaskPriority {
+    Interactive,    // Something the user is waiting for: displayed z-slice, 3D views
+    Loading,        // Preview loading and z-slice prefetch
+    Export          // Background exports
+};
+
+class ThreadPool {
+public:
+    ThreadPool() = default;
+    explicit ThreadPool(int numThreads) { start(numThreads); }
+    ~ThreadPool() { shutdown(); }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void start(int numThreads);                     // No-op if already running
+    void submit(std::function<void()> task, TaskPriority priority = TaskPriority::Loading);
+    void shutdown();                                // Drop queued tasks, wait for running ones
+
+    int size() const { return (int)m_threads.size(); }
+
+private:
+    void workerLoop();
+
+    static const int kPriorities = 3;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::function<void()>> m_tasks[kPriorities];   // By TaskPriority
+    std::vector<std::thread> m_threads;
+    bool m_stopping = false;
+};
+
+// The process-wide pool; start() it with the thread count before submitting
+ThreadPool& SharedThreadPool();
+
+// Tasks submitted to a pool on behalf of one job, so the job can wait for all of
+// them. Tasks should be short (a frame or a run of frames) so that higher priority
+// work gets a worker soon. Tasks dropped by ThreadPool::shutdown count as finished.
+// Do not wait from a task of the same pool.
+class TaskGroup {
+public:
+    TaskGroup(ThreadPool& pool, TaskPriority priority) : m_pool(pool), m_priority(priority),
+                                                         m_state(std::make_shared<State>()) {}
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task) { run(std::move(task), m_priority); }
+    void run(std::function<void()> task, TaskPriority priority);
+    void wait();                                    // Until every task has run (or was dropped)
+    size_t pending() const;
+
+private:
+    struct State {
+        mutable std::mutex mutex;
+        std::condition_variable finished;
+        size_t pending = 0;
+    };
+
+    ThreadPool& m_pool;
+    TaskPriority m_priority;
+    std::shared_ptr<State> m_state;
+};
+
+#endif // THREAD_POOL_H
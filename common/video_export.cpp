@@ -0,0 +1,978 @@
+// Video export implementation
+// Render workers decode full-resolution frames and render the view; one writer
+// thread per segment feeds the frames, in order, to that segment's sink.
+// PNG sequences have no ordering constraint and are written by the workers directly.
+
+#include "video_export.h"
+#include "math_utils.h"
+#include "png_writer.h"
+#include "file_io.h"
+#include "thread_pool.h"
+#include "stb_image.h"
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Helper: render current view into RGB24 buffer using full-resolution image.
+// The output size is independent of the window: the region visible in the
+// window is mapped onto outW x outH according to settings.exportAspect.
+// Gray sources are coloured through lut, as the viewer draws them.
+static void RenderViewToBufferHQ(
+    unsigned char* buffer,
+    int outW,
+    int outH,
+    const unsigned char* src,
+    int srcW,
+    int srcH,
+    PixelFormat format,
+    const ColorLut& lut,
+    const ViewState& view,
+    const AppSettings& settings,
+    int displayedImageW,
+    int displayedImageH
+) {
+    // BUG FIX: Scale view parameters from displayed (shrunk) image to full-res image
+    // The view.panX/panY are in displayed image coordinates, need to scale to full-res
+    double scaleFactor = (double)srcW / displayedImageW;
+
+    ViewState scaledView = view;
+    scaledView.panX *= scaleFactor;
+    scaledView.panY *= scaleFactor;
+
+    ExportMapping mapping = CalculateExportMapping(scaledView, settings, srcW, srcH, outW, outH);
+
+    // Source column for every output column (-1 = outside the image)
+    std::vector<int> srcCols(outW);
+    for (int x = 0; x < outW; ++x) {
+        double fx = mapping.centerX + (x + 0.5 - outW / 2.0) / mapping.scaleX;
+        int sx = static_cast<int>(std::floor(fx));
+        srcCols[x] = (sx >= 0 && sx < srcW) ? sx : -1;
+    }
+
+    for (int y = 0; y < outH; ++y) {
+        unsigned char* dst = buffer + static_cast<size_t>(y) * outW * 3;
+        double fy = mapping.centerY + (y + 0.5 - outH / 2.0) / mapping.scaleY;
+        int sy = static_cast<int>(std::floor(fy));
+        if (sy < 0 || sy >= srcH) {
+            // Outside the image: black
+            std::memset(dst, 0, static_cast<size_t>(outW) * 3);
+            continue;
+        }
+        int bpp = BytesPerPixel(format);
+        const unsigned char* srcRow = src + static_cast<size_t>(sy) * srcW * bpp;
+        for (int x = 0; x < outW; ++x, dst += 3) {
+            int sx = srcCols[x];
+            if (sx < 0) {
+                dst[0] = dst[1] = dst[2] = 0;
+            } else if (format == PixelFormat::RGB8) {
+                const unsigned char* srcPix = srcRow + static_cast<size_t>(sx) * 3;
+                dst[0] = srcPix[0];
+                dst[1] = srcPix[1];
+                dst[2] = srcPix[2];
+            } else {
+                uint32_t colour = (format == PixelFormat::Gray16)
+                    ? lut.lookup(reinterpret_cast<const uint16_t*>(srcRow)[sx])
+                    : lut.lookup(srcRow[sx]);
+                dst[0] = static_cast<unsigned char>(colour);
+                dst[1] = static_cast<unsigned char>(colour >> 8);
+                dst[2] = static_cast<unsigned char>(colour >> 16);
+            }
+        }
+    }
+}
+
+const char* ExportFormatExtension(ExportFormat format) {
+    switch (format) {
+        case ExportFormat::FFV1: return ".mkv";
+        case ExportFormat::Raw:  return ".rgb";
+        case ExportFormat::Y4M:  return ".y4m";
+        case ExportFormat::PNG:  return "";
+        default:                 return ".mp4";
+    }
+}
+
+// Destination for one segment's frames, written in frame order
+class FrameSink {
+public:
+    virtual ~FrameSink() {}
+    virtual bool write(const unsigned char* rgb) = 0;
+    // Flush and close; false if the destination reported an error
+    virtual bool finish() = 0;
+};
+
+// ffmpeg process reading raw RGB24 on stdin (H.264 or FFV1)
+class EncoderSink : public FrameSink {
+public:
+    EncoderSink(FILE* pipe, size_t frameSize) : m_pipe(pipe), m_frameSize(frameSize) {}
+    ~EncoderSink() override { finish(); }
+
+    bool write(const unsigned char* rgb) override {
+        return std::fwrite(rgb, 1, m_frameSize, m_pipe) == m_frameSize;
+    }
+
+    bool finish() override {
+        if (!m_pipe) return true;
+        bool ok = pclose(m_pipe) == 0;
+        m_pipe = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* m_pipe;
+    size_t m_frameSize;
+};
+
+// Uncompressed stream to a file or stdout: raw RGB24 frames or YUV4MPEG2 4:4:4
+class StreamSink : public FrameSink {
+public:
+    StreamSink(FILE* file, bool ownsFile, bool y4m, int width, int height)
+        : m_file(file), m_ownsFile(ownsFile), m_y4m(y4m), m_width(width), m_height(height) {
+        if (m_y4m) {
+            m_planes.resize(static_cast<size_t>(width) * height * 3);
+        }
+    }
+    ~StreamSink() override { finish(); }
+
+    bool writeHeader(int fps) {
+        if (!m_y4m) return true;
+        return std::fprintf(m_file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", m_width, m_height, fps) > 0;
+    }
+
+    bool write(const unsigned char* rgb) override {
+        size_t pixels = static_cast<size_t>(m_width) * m_height;
+        if (!m_y4m) {
+            return std::fwrite(rgb, 1, pixels * 3, m_file) == pixels * 3;
+        }
+
+        // BT.601 limited range, planar Y, U, V
+        unsigned char* yPlane = m_planes.data();
+        unsigned char* uPlane = yPlane + pixels;
+        unsigned char* vPlane = uPlane + pixels;
+        for (size_t i = 0; i < pixels; ++i) {
+            int r = rgb[i * 3 + 0];
+            int g = rgb[i * 3 + 1];
+            int b = rgb[i * 3 + 2];
+            yPlane[i] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            uPlane[i] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            vPlane[i] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+        return std::fputs("FRAME\n", m_file) >= 0
+            && std::fwrite(m_planes.data(), 1, m_planes.size(), m_file) == m_planes.size();
+    }
+
+    bool finish() override {
+        if (!m_file) return true;
+        bool ok = std::fflush(m_file) == 0;
+        if (m_ownsFile && std::fclose(m_file) != 0) ok = false;
+        m_file = nullptr;
+        return ok;
+    }
+
+private:
+    FILE* m_file;
+    bool m_ownsFile;
+    bool m_y4m;
+    int m_width;
+    int m_height;
+    std::vector<unsigned char> m_planes;
+};
+
+// encoderThreads > 0 limits the threads of the ffmpeg process
+static std::unique_ptr<FrameSink> CreateSink(const ExportJob& job, const std::string& file, int encoderThreads) {
+    size_t frameSize = static_cast<size_t>(job.outWidth) * job.outHeight * 3;
+
+    if (job.format == ExportFormat::Raw || job.format == ExportFormat::Y4M) {
+        bool toStdout = (file == "-");
+        FILE* out = toStdout ? stdout : std::fopen(file.c_str(), "wb");
+        if (!out) {
+            std::cerr << "Could not open output: " << file << std::endl;
+            return nullptr;
+        }
+        auto sink = std::make_unique<StreamSink>(out, !toStdout, job.format == ExportFormat::Y4M,
+                                                 job.outWidth, job.outHeight);
+        if (!sink->writeHeader(job.fps)) {
+            std::cerr << "Could not write to: " << file << std::endl;
+            return nullptr;
+        }
+        return sink;
+    }
+
+    // Encoders may run in parallel or in the background: only errors are printed
+    std::string threadArgs;
+    if (encoderThreads > 0) {
+        threadArgs = "-threads " + std::to_string(encoderThreads) + " ";
+    }
+    const char* codecArgs = (job.format == ExportFormat::FFV1)
+        ? "-c:v ffv1 -level 3 -g 1 -slices 16 -slicecrc 1 -pix_fmt bgr0"
+        : "-c:v libx264 -pix_fmt yuv444p -crf 18";
+
+    char cmd[1024];
+    std::snprintf(cmd, sizeof(cmd),
+        "ffmpeg -y -loglevel error -f rawvideo -pixel_format rgb24 -video_size %dx%d -framerate %d -i - "
+        "%s%s \"%s\"",
+        job.outWidth, job.outHeight, job.fps, threadArgs.c_str(), codecArgs, file.c_str());
+
+    FILE* pipe = popen(cmd, "w");
+    if (!pipe) {
+        std::cerr << "Failed to start ffmpeg. Is it installed and in PATH?" << std::endl;
+        return nullptr;
+    }
+    return std::make_unique<EncoderSink>(pipe, frameSize);
+}
+
+// Output frames an export may hold at once (rendered, waiting for or being written):
+// a background export shares RAM with the previews, however many threads it has
+static const size_t kExportFrameBudget = 512u << 20;
+
+// Output frame buffers reused for the whole export, so frames are not allocated
+// (and faulted in) one by one
+class FrameBufferPool {
+public:
+    explicit FrameBufferPool(size_t bytes) : m_bytes(bytes) {}
+    ~FrameBufferPool() {
+        for (unsigned char* buffer : m_free) delete[] buffer;
+    }
+
+    unsigned char* acquire() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_free.empty()) {
+                unsigned char* buffer = m_free.back();
+                m_free.pop_back();
+                return buffer;
+            }
+        }
+        return new unsigned char[m_bytes];
+    }
+
+    void release(unsigned char* buffer) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.push_back(buffer);
+    }
+
+private:
+    size_t m_bytes;
+    std::mutex m_mutex;
+    std::vector<unsigned char*> m_free;
+};
+
+// One contiguous range of frames written to its own sink
+struct ExportSegment {
+    size_t begin = 0;               // First frame (inclusive)
+    size_t end = 0;                 // Last frame (exclusive)
+    std::string file;               // Output of this segment's sink
+};
+
+// One encoder at a time writing a list of segments back to back
+struct ExportLane {
+    std::vector<size_t> segments;   // Segment indices, in write order
+    std::vector<size_t> frames;     // Frame indices of those segments, in write order
+    size_t nextToWrite = 0;         // Position in frames the writer needs next
+    std::map<size_t, unsigned char*> rendered;  // Rendered frames by position, waiting for the writer
+    std::vector<size_t> parked;     // Render tasks too far ahead of the writer, resubmitted by it
+};
+
+// "out.mp4" -> "out.part003.mp4"
+static std::string SegmentFileName(const std::string& outputFile, size_t segment) {
+    size_t lastSlash = outputFile.find_last_of('/');
+    size_t dotPos = outputFile.rfind('.');
+    if (dotPos == std::string::npos || (lastSlash != std::string::npos && dotPos < lastSlash)) {
+        dotPos = outputFile.size();
+    }
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".part%03zu", segment);
+    return outputFile.substr(0, dotPos) + suffix + outputFile.substr(dotPos);
+}
+
+// PNG sequence frame name; matches the *_<number>.png pattern so exports can be reopened
+static std::string PngFrameName(const std::string& directory, size_t frame) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/export_%06zu.png", frame);
+    return directory + name;
+}
+
+static bool FileExists(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static bool ParseExportFormat(const std::string& name, ExportFormat& format) {
+    for (ExportFormat f : {ExportFormat::H264, ExportFormat::FFV1, ExportFormat::Raw,
+                           ExportFormat::Y4M, ExportFormat::PNG}) {
+        if (name == ExportFormatName(f)) {
+            format = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseExportAspect(const std::string& name, ExportAspect& aspect) {
+    for (ExportAspect a : {ExportAspect::Fit, ExportAspect::Fill, ExportAspect::Stretch}) {
+        if (name == ExportAspectName(a)) {
+            aspect = a;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Checkpoint manifest (<output>.manifest): the parameters that define the
+// output, followed by one "done <segment>" line appended per finished segment
+static bool WriteManifest(const std::string& path, const ExportJob& job, size_t segmentFrames) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        std::cerr << "Could not write export manifest: " << path << std::endl;
+        return false;
+    }
+    std::fprintf(file, "png_viewer_export 1\n");
+    std::fprintf(file, "frames %zu\n", job.files.size());
+    std::fprintf(file, "first %s\n", job.files.path(0).c_str());
+    std::fprintf(file, "last %s\n", job.files.path(job.files.size() - 1).c_str());
+    std::fprintf(file, "format %s\n", ExportFormatName(job.format));
+    std::fprintf(file, "size %d %d\n", job.outWidth, job.outHeight);
+    std::fprintf(file, "fps %d\n", job.fps);
+    std::fprintf(file, "aspect %s\n", ExportAspectName(job.settings.exportAspect));
+    std::fprintf(file, "window %d %d\n", job.settings.windowWidth, job.settings.windowHeight);
+    std::fprintf(file, "displayed %d %d\n", job.displayedWidth, job.displayedHeight);
+    std::fprintf(file, "view %.17g %.17g %.17g\n", job.view.zoomLevel, job.view.panX, job.view.panY);
+    std::fprintf(file, "segment_frames %zu\n", segmentFrames);
+    bool ok = std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (std::fclose(file) != 0) ok = false;
+    return ok;
+}
+
+static bool MarkSegmentDone(const std::string& path, size_t segment) {
+    FILE* file = std::fopen(path.c_str(), "a");
+    if (!file) return false;
+    std::fprintf(file, "done %zu\n", segment);
+    bool ok = std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (std::fclose(file) != 0) ok = false;
+    return ok;
+}
+
+// Restore an interrupted export: if the manifest describes the same source
+// sequence, adopt its output parameters (view, size, format) into job.
+static bool ReadManifest(const std::string& path, ExportJob& job,
+                         size_t& segmentFrames, std::set<size_t>& doneSegments) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    ExportJob restored = job;
+    size_t frames = 0;
+    std::string first, last;
+    segmentFrames = 0;
+    doneSegments.clear();
+
+    std::string line;
+    if (!std::getline(in, line) || line != "png_viewer_export 1") return false;
+    while (std::getline(in, line)) {
+        size_t space = line.find(' ');
+        std::string key = line.substr(0, space);
+        std::string value = (space == std::string::npos) ? "" : line.substr(space + 1);
+        std::istringstream fields(value);
+
+        if (key == "frames") fields >> frames;
+        else if (key == "first") first = value;
+        else if (key == "last") last = value;
+        else if (key == "format") { if (!ParseExportFormat(value, restored.format)) return false; }
+        else if (key == "size") fields >> restored.outWidth >> restored.outHeight;
+        else if (key == "fps") fields >> restored.fps;
+        else if (key == "aspect") { if (!ParseExportAspect(value, restored.settings.exportAspect)) return false; }
+        else if (key == "window") fields >> restored.settings.windowWidth >> restored.settings.windowHeight;
+        else if (key == "displayed") fields >> restored.displayedWidth >> restored.displayedHeight;
+        else if (key == "view") fields >> restored.view.zoomLevel >> restored.view.panX >> restored.view.panY;
+        else if (key == "segment_frames") fields >> segmentFrames;
+        else if (key == "done") {
+            size_t segment;
+            if (fields >> segment) doneSegments.insert(segment);
+        }
+    }
+
+    if (frames != job.files.size() || first != job.files.path(0) || last != job.files.path(job.files.size() - 1)) {
+        std::cerr << "Export manifest " << path << " belongs to a different image sequence" << std::endl;
+        return false;
+    }
+    if (segmentFrames == 0 || restored.outWidth <= 0 || restored.outHeight <= 0) {
+        return false;
+    }
+
+    job = restored;
+    return true;
+}
+
+// Losslessly join the segment files into the final output (ffmpeg concat demuxer, stream copy)
+static bool ConcatSegments(const std::vector<ExportSegment>& segments, const std::string& outputFile) {
+    std::string listFile = outputFile + ".concat.txt";
+    FILE* list = std::fopen(listFile.c_str(), "w");
+    if (!list) {
+        std::cerr << "Could not write segment list: " << listFile << std::endl;
+        return false;
+    }
+    for (const auto& seg : segments) {
+        // Quote for the concat demuxer: ' -> '\''
+        std::string quoted;
+        for (char c : seg.file) {
+            if (c == '\'') quoted += "'\\''";
+            else quoted += c;
+        }
+        std::fprintf(list, "file '%s'\n", quoted.c_str());
+    }
+    std::fclose(list);
+
+    char cmd[2048];
+    std::snprintf(cmd, sizeof(cmd),
+        "ffmpeg -y -loglevel error -f concat -safe 0 -i \"%s\" -c copy \"%s\"",
+        listFile.c_str(), outputFile.c_str());
+    bool success = std::system(cmd) == 0;
+
+    std::remove(listFile.c_str());
+    if (success) {
+        for (const auto& seg : segments) {
+            std::remove(seg.file.c_str());
+        }
+    } else {
+        std::cerr << "Concatenating segments failed, segment files kept" << std::endl;
+    }
+    return success;
+}
+
+// Join raw/Y4M segment files into the final output by appending them; every Y4M
+// segment starts with its own stream header, so only the first one is kept
+static bool ConcatStreamSegments(const std::vector<ExportSegment>& segments, const std::string& outputFile,
+                                 bool y4m) {
+    FILE* out = std::fopen(outputFile.c_str(), "wb");
+    if (!out) {
+        std::cerr << "Could not open output: " << outputFile << std::endl;
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    bool success = true;
+    for (size_t s = 0; s < segments.size() && success; ++s) {
+        FILE* in = std::fopen(segments[s].file.c_str(), "rb");
+        if (!in) {
+            std::cerr << "Could not open segment: " << segments[s].file << std::endl;
+            success = false;
+            break;
+        }
+        if (y4m && s > 0) {
+            int c;
+            while ((c = std::fgetc(in)) != EOF && c != '\n') {}
+        }
+        size_t n;
+        while ((n = std::fread(buffer.data(), 1, buffer.size(), in)) > 0) {
+            if (std::fwrite(buffer.data(), 1, n, out) != n) {
+                success = false;
+                break;
+            }
+        }
+        if (std::ferror(in)) success = false;
+        std::fclose(in);
+    }
+    if (std::fclose(out) != 0) success = false;
+
+    if (success) {
+        for (const auto& seg : segments) {
+            std::remove(seg.file.c_str());
+        }
+    } else {
+        std::cerr << "Concatenating segments failed, segment files kept" << std::endl;
+    }
+    return success;
+}
+
+bool RunExport(const ExportJob& requestedJob, ProgressCallback progressCallback) {
+    ExportJob job = requestedJob;
+    size_t totalFrames = job.files.size();
+    if (totalFrames == 0) {
+        std::cerr << "No images loaded to export!" << std::endl;
+        return false;
+    }
+
+    // Only encoded formats benefit from parallel segments; streams go to one
+    // destination and PNG frames are already written in parallel
+    bool encodedFormat = (job.format == ExportFormat::H264 || job.format == ExportFormat::FFV1);
+    bool workersWrite = (job.format == ExportFormat::PNG);
+    // Raw/Y4M files can be written in segments too (not stdout, which is one stream)
+    bool streamFile = (job.format == ExportFormat::Raw || job.format == ExportFormat::Y4M) && job.outputFile != "-";
+
+    // Checkpointed exports write fixed-size segments and record finished ones
+    // in a manifest, so an interrupted export can resume where it stopped
+    std::string manifestFile = job.outputFile + ".manifest";
+    std::set<size_t> doneSegments;
+    size_t segmentFrames = 0;
+    bool checkpointed = false;
+    if ((encodedFormat || streamFile) && job.resume) {
+        if (ReadManifest(manifestFile, job, segmentFrames, doneSegments)) {
+            checkpointed = true;
+            encodedFormat = (job.format == ExportFormat::H264 || job.format == ExportFormat::FFV1);
+            streamFile = (job.format == ExportFormat::Raw || job.format == ExportFormat::Y4M);
+            std::cout << "Resuming export from " << manifestFile << " ("
+                      << doneSegments.size() << " segments already done)" << std::endl;
+        } else {
+            std::cout << "No usable export manifest, starting a new export" << std::endl;
+        }
+    }
+    if ((encodedFormat || streamFile) && !checkpointed && job.checkpointFrames > 0) {
+        checkpointed = true;
+        segmentFrames = static_cast<size_t>(job.checkpointFrames);
+        if (!WriteManifest(manifestFile, job, segmentFrames)) {
+            return false;
+        }
+    }
+
+    // Render chains run on the shared pool, so its size (--threads) caps them
+    int numThreads = std::clamp(job.numThreads, 1, std::max(1, SharedThreadPool().size()));
+    int numEncoders = encodedFormat ? std::clamp(job.numSegments, 1, kMaxExportSegments) : 1;
+    size_t frameBufferSize = static_cast<size_t>(job.outWidth) * job.outHeight * 3;
+
+    if (workersWrite && mkdir(job.outputFile.c_str(), 0755) != 0 && errno != EEXIST) {
+        std::cerr << "Could not create directory: " << job.outputFile << std::endl;
+        return false;
+    }
+
+    // Split the frame range into contiguous segments
+    size_t numSegments = checkpointed
+        ? (totalFrames + segmentFrames - 1) / segmentFrames
+        : std::min<size_t>(numEncoders, totalFrames);
+    std::vector<ExportSegment> segments(numSegments);
+    for (size_t s = 0; s < numSegments; ++s) {
+        if (checkpointed) {
+            segments[s].begin = s * segmentFrames;
+            segments[s].end = std::min(totalFrames, (s + 1) * segmentFrames);
+        } else {
+            segments[s].begin = totalFrames * s / numSegments;
+            segments[s].end = totalFrames * (s + 1) / numSegments;
+        }
+        bool direct = (numSegments == 1 && !checkpointed);
+        segments[s].file = direct ? job.outputFile : SegmentFileName(job.outputFile, s);
+    }
+
+    // Distribute unfinished segments over the encoder lanes
+    std::vector<size_t> pending;
+    size_t skippedFrames = 0;
+    for (size_t s = 0; s < numSegments; ++s) {
+        if (doneSegments.count(s) && FileExists(segments[s].file)) {
+            skippedFrames += segments[s].end - segments[s].begin;
+        } else {
+            pending.push_back(s);
+        }
+    }
+    size_t numLanes = std::max<size_t>(1, std::min<size_t>(numEncoders, pending.size()));
+    std::vector<ExportLane> lanes(numLanes);
+    for (size_t i = 0; i < pending.size(); ++i) {
+        ExportLane& lane = lanes[i % numLanes];
+        const ExportSegment& seg = segments[pending[i]];
+        lane.segments.push_back(pending[i]);
+        for (size_t f = seg.begin; f < seg.end; ++f) {
+            lane.frames.push_back(f);
+        }
+    }
+    size_t maxLaneLength = 0;
+    for (const auto& lane : lanes) {
+        maxLaneLength = std::max(maxLaneLength, lane.frames.size());
+    }
+
+    std::mutex queueMutex;
+    std::condition_variable queueNotEmpty;
+    std::condition_variable progressChanged;
+    std::atomic<bool> cancelled(false);
+    size_t framesWritten = skippedFrames;
+    bool writeFailed = false;
+
+    // Frames a lane may have rendered ahead of its writer. Within kExportFrameBudget:
+    // every lane's window plus the frame its writer holds, or for PNG sequences one
+    // frame per render chain.
+    size_t budgetFrames = std::max<size_t>(2 * numLanes, kExportFrameBudget / frameBufferSize);
+    size_t aheadLimit = std::clamp<size_t>(std::max<size_t>(2, static_cast<size_t>(numThreads) * 2 / numLanes),
+                                           1, budgetFrames / numLanes - 1);
+    if (workersWrite) {
+        numThreads = (int)std::min<size_t>(numThreads, budgetFrames);
+    }
+    FrameBufferPool frameBuffers(frameBufferSize);
+    // An explicit encoder thread budget is split between the lanes; parallel
+    // lanes otherwise share as many threads as there are render workers
+    int encoderThreads = 0;
+    if (job.encoderThreads > 0) {
+        encoderThreads = std::max(1, job.encoderThreads / (int)numLanes);
+    } else if (numLanes > 1) {
+        encoderThreads = std::max(1, numThreads / (int)numLanes);
+    }
+    std::atomic<size_t> nextTask(0);
+
+    // g_interrupted is set from a signal handler without notifying, so waits poll
+    auto stopRequested = [&]() { return cancelled.load() || g_interrupted.load(); };
+    const auto pollInterval = std::chrono::milliseconds(100);
+
+    // Source files in the order the render workers take them, hinted ahead by the I/O threads
+    ReadAhead readAhead;
+    if (job.ioThreads > 0) {
+        std::vector<std::string> readOrder;
+        for (size_t task = 0; task < maxLaneLength * numLanes; ++task) {
+            const ExportLane& lane = lanes[task % numLanes];
+            if (task / numLanes < lane.frames.size()) {
+                readOrder.push_back(job.files.path(lane.frames[task / numLanes]));
+            }
+        }
+        readAhead.start(std::move(readOrder), job.ioThreads, (size_t)std::max(numThreads, job.ioThreads) * 4);
+    }
+
+    // Render one claimed task (tasks interleave the lanes so every encoder is kept fed)
+    auto renderFrame = [&](size_t task) {
+        size_t pos = task / numLanes;
+        ExportLane& lane = lanes[task % numLanes];
+        if (pos >= lane.frames.size()) return;
+        size_t idx = lane.frames[pos];
+        readAhead.consumed();
+
+        // PNG frames are complete once renamed into place
+        std::string pngFile;
+        if (workersWrite) {
+            pngFile = PngFrameName(job.outputFile, idx);
+            if (job.resume && FileExists(pngFile)) {
+                {
+                    std::lock_guard<std::mutex> lock(queueMutex);
+                    ++framesWritten;
+                }
+                progressChanged.notify_all();
+                return;
+            }
+        }
+
+        unsigned char* buffer = frameBuffers.acquire();
+
+        // Gray sources are decoded at full size in their native format
+        // (AllocFrameBuffer, like previews) so the colormap sees every bit
+        int w, h;
+        bool gray = job.pixelFormat != PixelFormat::RGB8;
+        unsigned char* data = gray
+            ? LoadAndShrinkImage(job.files.path(idx), 1, w, h, true, false, job.pixelFormat)
+            : LoadImageFile(job.files.path(idx), w, h);
+        if (data) {
+            // BUG FIX: Pass displayed image dimensions for proper view scaling
+            RenderViewToBufferHQ(buffer, job.outWidth, job.outHeight,
+                                 data, w, h, job.pixelFormat, job.colorLut,
+                                 job.view, job.settings,
+                                 job.displayedWidth, job.displayedHeight);
+            if (gray) {
+                FreeFrameBuffer(data);
+            } else {
+                FreeImage(data);
+            }
+        } else {
+            std::memset(buffer, 0, frameBufferSize);    // Unreadable source: black frame
+        }
+
+        if (workersWrite) {
+            std::string tmpFile = pngFile + ".tmp";
+            bool ok = WritePNG(tmpFile, buffer, job.outWidth, job.outHeight)
+                      && std::rename(tmpFile.c_str(), pngFile.c_str()) == 0;
+            frameBuffers.release(buffer);
+            {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                ++framesWritten;
+                if (!ok) {
+                    writeFailed = true;
+                    cancelled.store(true);
+                }
+            }
+            progressChanged.notify_all();
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            lane.rendered[pos] = buffer;
+        }
+        queueNotEmpty.notify_all();
+    };
+
+    // Rendering runs on the shared pool as numThreads chains of one-frame tasks at
+    // export priority, so loading and interactive work get a worker between frames.
+    // A pool task never waits for the encoder: a chain whose next frame is too far
+    // ahead of its lane's writer parks the task, and the writer resubmits it once it
+    // has drained enough. Bounding by distance from the writer rather than by queue
+    // size means the frame the writer needs can always be rendered.
+    TaskGroup renderTasks(SharedThreadPool(), TaskPriority::Export);
+    std::function<void(size_t)> renderChain = [&](size_t task) {
+        if (stopRequested() || task / numLanes >= maxLaneLength) return;
+        ExportLane& lane = lanes[task % numLanes];
+        if (!workersWrite && task / numLanes < lane.frames.size()) {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (task / numLanes >= lane.nextToWrite + aheadLimit) {
+                lane.parked.push_back(task);
+                return;
+            }
+        }
+        renderFrame(task);
+        renderTasks.run([&]() { renderChain(nextTask.fetch_add(1)); });
+    };
+
+    std::mutex manifestMutex;
+    auto laneWriter = [&](ExportLane& lane) {
+        auto fail = [&]() {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            writeFailed = true;
+            cancelled.store(true);
+        };
+
+        for (size_t segIdx : lane.segments) {
+            const ExportSegment& seg = segments[segIdx];
+            std::unique_ptr<FrameSink> sink = CreateSink(job, seg.file, encoderThreads);
+            if (!sink) {
+                fail();
+                return;
+            }
+
+            size_t segEnd = lane.nextToWrite + (seg.end - seg.begin);
+            bool ok = true;
+            while (lane.nextToWrite < segEnd) {
+                unsigned char* frameData = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(queueMutex);
+                    while (!stopRequested() && lane.rendered.find(lane.nextToWrite) == lane.rendered.end()) {
+                        queueNotEmpty.wait_for(lock, pollInterval);
+                    }
+                    if (stopRequested()) break;
+
+                    auto it = lane.rendered.find(lane.nextToWrite);
+                    frameData = it->second;
+                    lane.rendered.erase(it);
+                }
+
+                ok = sink->write(frameData);
+                frameBuffers.release(frameData);
+
+                // Advanced together with the parking check, so no chain is left parked
+                std::vector<size_t> resume;
+                {
+                    std::lock_guard<std::mutex> lock(queueMutex);
+                    ++lane.nextToWrite;
+                    ++framesWritten;
+                    auto ready = std::partition(lane.parked.begin(), lane.parked.end(), [&](size_t task) {
+                        return task / numLanes >= lane.nextToWrite + aheadLimit;
+                    });
+                    resume.assign(ready, lane.parked.end());
+                    lane.parked.erase(ready, lane.parked.end());
+                }
+                for (size_t task : resume) {
+                    renderTasks.run([&, task]() { renderChain(task); });
+                }
+                progressChanged.notify_all();
+                if (!ok) break;
+            }
+
+            bool complete = ok && lane.nextToWrite == segEnd;
+            bool finished = sink->finish();
+            if (!ok || (complete && !finished)) {
+                fail();
+                return;
+            }
+            if (!complete) return;  // Stopped part-way; the segment is redone on resume
+
+            if (checkpointed) {
+                std::lock_guard<std::mutex> lock(manifestMutex);
+                if (!MarkSegmentDone(manifestFile, segIdx)) {
+                    std::cerr << "Could not update export manifest: " << manifestFile << std::endl;
+                }
+            }
+        }
+    };
+
+    for (int i = 0; i < numThreads; ++i) {
+        renderTasks.run([&]() { renderChain(nextTask.fetch_add(1)); });
+    }
+    std::vector<std::thread> writers;
+    if (!workersWrite) {
+        writers.reserve(numLanes);
+        for (auto& lane : lanes) {
+            if (!lane.segments.empty()) {
+                writers.emplace_back(laneWriter, std::ref(lane));
+            }
+        }
+    }
+
+    // Report progress from the calling thread
+    size_t reported = 0;
+    while (true) {
+        size_t written;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            progressChanged.wait_for(lock, pollInterval, [&]() {
+                return framesWritten != reported || stopRequested();
+            });
+            written = framesWritten;
+        }
+        if (written != reported) {
+            reported = written;
+            if (progressCallback && !progressCallback((int)written, (int)totalFrames)) {
+                cancelled.store(true);
+            }
+        }
+        if (written >= totalFrames || stopRequested()) break;
+    }
+
+    // Writers resubmit parked render tasks, so they are joined first
+    queueNotEmpty.notify_all();
+    for (auto& t : writers) {
+        if (t.joinable()) t.join();
+    }
+    renderTasks.wait();
+    readAhead.stop();
+
+    for (auto& lane : lanes) {
+        for (auto& entry : lane.rendered) {
+            frameBuffers.release(entry.second);
+        }
+        lane.rendered.clear();
+    }
+
+    if (writeFailed) {
+        std::cerr << "\nWriting export output failed (encoder exited early or disk full?)" << std::endl;
+        return false;
+    }
+    if (stopRequested()) {
+        if (checkpointed) {
+            std::cout << "\nCompleted segments are recorded in " << manifestFile
+                      << "; rerun with --export-resume to continue" << std::endl;
+        }
+        return false;
+    }
+
+    if (numSegments > 1 || checkpointed) {
+        std::cout << "\nConcatenating " << numSegments << " segments..." << std::endl;
+        bool joined = encodedFormat ? ConcatSegments(segments, job.outputFile)
+                                    : ConcatStreamSegments(segments, job.outputFile, job.format == ExportFormat::Y4M);
+        if (!joined) {
+            return false;
+        }
+        if (checkpointed) {
+            std::remove(manifestFile.c_str());
+        }
+    }
+    return true;
+}
+
+void ExportQueue::setCallbacks(JobProgressCallback onProgress, JobDoneCallback onDone) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_onProgress = onProgress;
+    m_onDone = onDone;
+}
+
+void ExportQueue::enqueue(const ExportJob& job) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(job);
+    m_stopping = false;
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&ExportQueue::run, this);
+    }
+    m_wake.notify_one();
+}
+
+void ExportQueue::cancelCurrent() {
+    m_cancelCurrent.store(true);
+}
+
+void ExportQueue::cancelAll() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.clear();
+    m_cancelCurrent.store(true);
+}
+
+void ExportQueue::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.clear();
+        m_stopping = true;
+        m_cancelCurrent.store(true);
+    }
+    m_wake.notify_one();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool ExportQueue::busy() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_status.running || !m_jobs.empty();
+}
+
+bool ExportQueue::hasOutput(const std::string& outputFile) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_status.running && m_status.outputFile == outputFile) return true;
+    for (const auto& job : m_jobs) {
+        if (job.outputFile == outputFile) return true;
+    }
+    return false;
+}
+
+ExportQueueStatus ExportQueue::status() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ExportQueueStatus status = m_status;
+    status.queued = m_jobs.size();
+    return status;
+}
+
+void ExportQueue::run() {
+    while (true) {
+        ExportJob job;
+        JobProgressCallback onProgress;
+        JobDoneCallback onDone;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]() { return m_stopping || !m_jobs.empty(); });
+            if (m_stopping) break;
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            m_cancelCurrent.store(false);
+            m_status.running = true;
+            m_status.framesDone = 0;
+            m_status.framesTotal = (int)job.files.size();
+            m_status.outputFile = job.outputFile;
+            onProgress = m_onProgress;
+            onDone = m_onDone;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto elapsed = [&]() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        };
+
+        bool success = RunExport(job, [&](int done, int total) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_status.framesDone = done;
+                m_status.framesTotal = total;
+            }
+            if (onProgress) onProgress(job, done, total, elapsed());
+            return !m_cancelCurrent.load();
+        });
+
+        bool cancelled = m_cancelCurrent.load();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_status = ExportQueueStatus();
+        }
+        if (onDone) onDone(job, success, cancelled, elapsed());
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_status = ExportQueueStatus();
+}
@@ -0,0 +1,98 @@
+// Video export for PNG Image Viewer
+// Platform-independent multi-threaded rendering of the current view into a video
+// encoder (ffmpeg), a raw/Y4M stream or a PNG sequence
+
+#ifndef VIDEO_EXPORT_H
+#define VIDEO_EXPORT_H
+
+#include "frame_types.h"
+#include "image_loader.h"
+#include "color_lut.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Most encoder processes one export runs in parallel (--export-segments)
+const int kMaxExportSegments = 256;
+
+// Everything an export needs, captured by value so the viewer state can change
+// while the export runs
+struct ExportJob {
+    FileTable files;                        // Full-resolution frames, in playback order
+    std::string outputFile;                 // Final output file (directory for PNG, "-" = stdout for raw/Y4M)
+    ExportFormat format = ExportFormat::H264;
+    ViewState view;                         // View at the time export was started
+    PixelFormat pixelFormat = PixelFormat::RGB8;  // Preview format; gray frames are exported through colorLut
+    ColorLut colorLut;                      // Colour table in use when the export was started
+    AppSettings settings;                   // Window size and export aspect mode
+    int displayedWidth = 0;                 // Preview (shrunk) image dimensions the view refers to
+    int displayedHeight = 0;
+    int outWidth = 0;
+    int outHeight = 0;
+    int fps = 30;
+    int numThreads = 1;                     // Render tasks in flight on the shared pool (capped at its size)
+    int ioThreads = 0;                      // Read-ahead threads for the source files (0 = none)
+    int encoderThreads = 0;                 // ffmpeg thread budget (0 = ffmpeg default)
+    int numSegments = 1;                    // Encoder processes; >1 encodes segments in parallel and concatenates
+    int checkpointFrames = 0;               // >0: fixed-size segments recorded in <output>.manifest as they finish
+    bool resume = false;                    // Continue from <output>.manifest, or skip existing PNG frames
+};
+
+// File extension for an export format ("" for PNG, which writes a directory)
+const char* ExportFormatExtension(ExportFormat format);
+
+// Run an export to completion.
+// progressCallback receives (framesWritten, totalFrames); returning false cancels the export.
+// Returns false if the export failed or was cancelled/interrupted.
+bool RunExport(const ExportJob& job, ProgressCallback progressCallback = nullptr);
+
+// Snapshot of the export queue for progress overlays and window titles
+struct ExportQueueStatus {
+    bool running = false;           // A job is being exported
+    int framesDone = 0;             // Progress of the running job
+    int framesTotal = 0;
+    size_t queued = 0;              // Jobs waiting behind the running one
+    std::string outputFile;         // Output of the running job
+};
+
+// Runs export jobs one after another on a background thread so the viewer
+// stays interactive while exporting
+class ExportQueue {
+public:
+    // Called on the export thread: progress of the running job, and its result
+    using JobProgressCallback = std::function<void(const ExportJob& job, int done, int total, double seconds)>;
+    using JobDoneCallback = std::function<void(const ExportJob& job, bool success, bool cancelled, double seconds)>;
+
+    ExportQueue() = default;
+    ~ExportQueue() { shutdown(); }
+
+    void setCallbacks(JobProgressCallback onProgress, JobDoneCallback onDone);
+    void enqueue(const ExportJob& job);
+    void cancelCurrent();           // Running job stops, the next queued job starts
+    void cancelAll();               // Running job stops and the queue is cleared
+    void shutdown();                // cancelAll() and wait for the export thread
+
+    bool busy() const;
+    bool hasOutput(const std::string& outputFile) const;  // Queued or running
+    ExportQueueStatus status() const;
+
+private:
+    void run();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<ExportJob> m_jobs;
+    std::thread m_thread;
+    bool m_stopping = false;
+    std::atomic<bool> m_cancelCurrent{false};
+    ExportQueueStatus m_status;
+    JobProgressCallback m_onProgress;
+    JobDoneCallback m_onDone;
+};
+
+#endif // VIDEO_EXPORT_H
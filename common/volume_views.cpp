@@ -0,0 +1,280 @@
+// Volume views implementation
+
+#include "volume_views.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+bool UpdateCrossSection(CrossSection& section, SliceView view, int frame, int position,
+                        const std::vector<const unsigned char*>& slices,
+                        int width, int height, PixelFormat format, int numThreads) {
+    if (section.view == view && section.frame == frame && section.position == position &&
+        section.format == format && section.slices == slices && !section.pixels.empty()) {
+        return false;
+    }
+
+    int numZ = (int)slices.size();
+    int length = (view == SliceView::YZ) ? height : width;
+    position = std::clamp(position, 0, (view == SliceView::YZ ? width : height) - 1);
+
+    section.view = view;
+    section.frame = frame;
+    section.position = position;
+    section.slices = slices;
+    section.width = length;
+    section.height = numZ;
+    section.format = format;
+    size_t bpp = BytesPerPixel(format);
+    section.pixels.assign((size_t)length * numZ * bpp, 0);
+
+    // Output row r holds slice numZ-1-r so that z increases upwards
+    auto gatherRows = [&](int zBegin, int zEnd) {
+        for (int z = zBegin; z < zEnd; ++z) {
+            const unsigned char* src = slices[z];
+            if (!src) continue;
+            unsigned char* dst = section.pixels.data() + (size_t)(numZ - 1 - z) * length * bpp;
+
+            if (view == SliceView::XZ) {
+                memcpy(dst, src + (size_t)position * width * bpp, (size_t)width * bpp);
+            } else {
+                // Column gather: one pixel per image row
+                const unsigned char* column = src + (size_t)position * bpp;
+                for (int y = 0; y < height; ++y) {
+                    memcpy(dst + (size_t)y * bpp, column + (size_t)y * width * bpp, bpp);
+                }
+            }
+        }
+    };
+
+    // Only split the work when each thread gets a few hundred KB of rows to touch
+    size_t bytes = section.pixels.size();
+    int threads = std::clamp((int)(bytes / (256 * 1024)), 1, std::max(1, std::min(numThreads, numZ)));
+    if (threads == 1) {
+        gatherRows(0, numZ);
+        return true;
+    }
+
+    TaskGroup bands(SharedThreadPool(), TaskPriority::Interactive);
+    int perThread = (numZ + threads - 1) / threads;
+    for (int t = 0; t < threads; ++t) {
+        int zBegin = t * perThread;
+        int zEnd = std::min(numZ, zBegin + perThread);
+        if (zBegin < zEnd) {
+            bands.run([&, zBegin, zEnd]() { gatherRows(zBegin, zEnd); });
+        }
+    }
+    bands.wait();
+    return true;
+}
+
+// Fold bytes [begin, end) of one slice into the projection
+static void FoldSlice(Projection& projection, const unsigned char* src, size_t begin, size_t end) {
+    unsigned char* dst = projection.pixels.data();
+    size_t i = begin;
+
+    switch (projection.op) {
+        case ProjectionOp::Max:
+#ifdef __SSE2__
+            for (; i + 16 <= end; i += 16) {
+                __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+                __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_max_epu8(a, b));
+            }
+#endif
+            for (; i < end; ++i) dst[i] = std::max(dst[i], src[i]);
+            break;
+
+        case ProjectionOp::Min:
+#ifdef __SSE2__
+            for (; i + 16 <= end; i += 16) {
+                __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+                __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_min_epu8(a, b));
+            }
+#endif
+            for (; i < end; ++i) dst[i] = std::min(dst[i], src[i]);
+            break;
+
+        case ProjectionOp::Mean: {
+            uint32_t* sum = projection.sum.data();
+#ifdef __SSE2__
+            // Widen 16 bytes to four vectors of 32-bit lanes and add them to the sums
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= end; i += 16) {
+                __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+                __m128i lo16 = _mm_unpacklo_epi8(b, zero);
+                __m128i hi16 = _mm_unpackhi_epi8(b, zero);
+                __m128i* s = (__m128i*)(sum + i);
+                _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(lo16, zero)));
+                _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(lo16, zero)));
+                _mm_storeu_si128(s + 2, _mm_add_epi32(_mm_loadu_si128(s + 2), _mm_unpacklo_epi16(hi16, zero)));
+                _mm_storeu_si128(s + 3, _mm_add_epi32(_mm_loadu_si128(s + 3), _mm_unpackhi_epi16(hi16, zero)));
+            }
+#endif
+            for (; i < end; ++i) sum[i] += src[i];
+            break;
+        }
+    }
+}
+
+#ifdef __SSE2__
+// Unsigned 16-bit max/min from the signed SSE2 ones, with the sign bit flipped
+static inline __m128i MaxU16(__m128i a, __m128i b) {
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    return _mm_xor_si128(_mm_max_epi16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)), bias);
+}
+
+static inline __m128i MinU16(__m128i a, __m128i b) {
+    const __m128i bias = _mm_set1_epi16((short)0x8000);
+    return _mm_xor_si128(_mm_min_epi16(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)), bias);
+}
+#endif
+
+// Fold 16-bit samples [begin, end) of one slice into the projection
+static void FoldSlice16(Projection& projection, const uint16_t* src, size_t begin, size_t end) {
+    uint16_t* dst = (uint16_t*)projection.pixels.data();
+    size_t i = begin;
+
+    switch (projection.op) {
+        case ProjectionOp::Max:
+#ifdef __SSE2__
+            for (; i + 8 <= end; i += 8) {
+                __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+                __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+                _mm_storeu_si128((__m128i*)(dst + i), MaxU16(a, b));
+            }
+#endif
+            for (; i < end; ++i) dst[i] = std::max(dst[i], src[i]);
+            break;
+
+        case ProjectionOp::Min:
+#ifdef __SSE2__
+            for (; i + 8 <= end; i += 8) {
+                __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+                __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+                _mm_storeu_si128((__m128i*)(dst + i), MinU16(a, b));
+            }
+#endif
+            for (; i < end; ++i) dst[i] = std::min(dst[i], src[i]);
+            break;
+
+        case ProjectionOp::Mean: {
+            uint32_t* sum = projection.sum.data();
+#ifdef __SSE2__
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 8 <= end; i += 8) {
+                __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+                __m128i* s = (__m128i*)(sum + i);
+                _mm_storeu_si128(s + 0, _mm_add_epi32(_mm_loadu_si128(s + 0), _mm_unpacklo_epi16(b, zero)));
+                _mm_storeu_si128(s + 1, _mm_add_epi32(_mm_loadu_si128(s + 1), _mm_unpackhi_epi16(b, zero)));
+            }
+#endif
+            for (; i < end; ++i) sum[i] += src[i];
+            break;
+        }
+    }
+}
+
+const Projection* ProjectionCache::update(ProjectionOp op, int frame,
+                                          const std::vector<const unsigned char*>& slices,
+                                          int width, int height, PixelFormat format, int numThreads) {
+    // Look up the frame, most recently used first
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Projection& p) {
+        return p.op == op && p.frame == frame && p.width == width && p.height == height && p.format == format;
+    });
+    if (it != m_entries.end()) {
+        m_entries.splice(m_entries.begin(), m_entries, it);
+    } else {
+        Projection projection;
+        projection.op = op;
+        projection.frame = frame;
+        projection.width = width;
+        projection.height = height;
+        projection.format = format;
+        size_t bytes = (size_t)width * height * BytesPerPixel(format);
+        projection.pixels.assign(bytes, op == ProjectionOp::Min ? 255 : 0);
+        if (op == ProjectionOp::Mean) {
+            // One sum per reduced element: bytes, or 16-bit samples
+            projection.sum.assign(format == PixelFormat::Gray16 ? bytes / 2 : bytes, 0);
+        }
+        m_entries.push_front(std::move(projection));
+    }
+    Projection& projection = m_entries.front();
+
+    // Only slices that arrived since the last update are folded in
+    projection.folded.resize(std::max(projection.folded.size(), slices.size()), false);
+    std::vector<const unsigned char*> newSlices;
+    for (size_t z = 0; z < slices.size(); ++z) {
+        if (slices[z] && !projection.folded[z]) {
+            newSlices.push_back(slices[z]);
+            projection.folded[z] = true;
+        }
+    }
+
+    if (!newSlices.empty()) {
+        int newCount = projection.count + (int)newSlices.size();
+        bool wide = (format == PixelFormat::Gray16);
+        size_t rowBytes = (size_t)width * BytesPerPixel(format);
+        size_t rowElements = wide ? (size_t)width : rowBytes;
+
+        // Each thread reduces a band of rows over all new slices, then finishes its band
+        auto reduceRows = [&](int rowBegin, int rowEnd) {
+            size_t begin = rowBegin * rowElements;
+            size_t end = rowEnd * rowElements;
+            for (const unsigned char* src : newSlices) {
+                if (wide) {
+                    FoldSlice16(projection, (const uint16_t*)src, begin, end);
+                } else {
+                    FoldSlice(projection, src, begin, end);
+                }
+            }
+            if (projection.op == ProjectionOp::Mean) {
+                float scale = 1.0f / newCount;
+                if (wide) {
+                    uint16_t* mean = (uint16_t*)projection.pixels.data();
+                    for (size_t i = begin; i < end; ++i) {
+                        mean[i] = (uint16_t)(projection.sum[i] * scale + 0.5f);
+                    }
+                } else {
+                    for (size_t i = begin; i < end; ++i) {
+                        projection.pixels[i] = (unsigned char)(projection.sum[i] * scale + 0.5f);
+                    }
+                }
+            }
+        };
+
+        size_t work = rowBytes * height * newSlices.size();
+        int threads = std::clamp((int)(work / (1024 * 1024)), 1, std::max(1, std::min(numThreads, height)));
+        if (threads == 1) {
+            reduceRows(0, height);
+        } else {
+            TaskGroup bands(SharedThreadPool(), TaskPriority::Interactive);
+            int perThread = (height + threads - 1) / threads;
+            for (int t = 0; t < threads; ++t) {
+                int rowBegin = t * perThread;
+                int rowEnd = std::min(height, rowBegin + perThread);
+                if (rowBegin < rowEnd) {
+                    bands.run([&, rowBegin, rowEnd]() { reduceRows(rowBegin, rowEnd); });
+                }
+            }
+            bands.wait();
+        }
+        projection.count = newCount;
+    }
+
+    // Drop least recently used projections beyond the budget (never the current one)
+    size_t total = 0;
+    for (auto entry = m_entries.begin(); entry != m_entries.end(); ) {
+        total += entry->bytes();
+        if (entry != m_entries.begin() && total > m_maxBytes) {
+            entry = m_entries.erase(entry);
+        } else {
+            ++entry;
+        }
+    }
+
+    return projection.count > 0 ? &projection : nullptr;
+}
@@ -0,0 +1,71 @@
+// Volume views for PNG Image Viewer (3D mode)
+// Cross-sections and projections through the stack of z-slices, built from the loaded previews
+
+#ifndef VOLUME_VIEWS_H
+#define VOLUME_VIEWS_H
+
+#include "frame_types.h"
+#include <vector>
+#include <list>
+#include <cstdint>
+
+// Cross-section image with the inputs it was built from, so it is only rebuilt
+// when the frame, cut position or set of resident slices changes
+struct CrossSection {
+    SliceView view = SliceView::XY;
+    int frame = -1;
+    int position = -1;
+    std::vector<const unsigned char*> slices;   // Source frame of each z (nullptr = not loaded)
+
+    int width = 0;
+    int height = 0;                             // One row per z-height
+    PixelFormat format = PixelFormat::RGB8;
+    std::vector<unsigned char> pixels;          // In the slices' format
+};
+
+// Build an XZ (row `position` of each slice) or YZ (column `position`) cross-section.
+// slices holds one width x height frame in `format` per z-height, lowest z first;
+// missing slices are drawn black. Rows are gathered in parallel.
+// Returns true if the section was rebuilt, false if the cached one still applies.
+bool UpdateCrossSection(CrossSection& section, SliceView view, int frame, int position,
+                        const std::vector<const unsigned char*>& slices,
+                        int width, int height, PixelFormat format, int numThreads);
+
+// Projection over z of one frame. Slices are folded in as they become available,
+// so the result grows towards the whole volume while slices are still loading;
+// a slice evicted later keeps its contribution.
+struct Projection {
+    ProjectionOp op = ProjectionOp::Max;
+    int frame = -1;
+    int width = 0;
+    int height = 0;
+    PixelFormat format = PixelFormat::RGB8;
+    std::vector<bool> folded;                   // z-slices already accumulated
+    int count = 0;
+    std::vector<uint32_t> sum;                  // Mean: per-sample sums
+    std::vector<unsigned char> pixels;          // Max/min result, or the mean of the sums
+
+    size_t bytes() const { return pixels.size() + sum.size() * sizeof(uint32_t); }
+};
+
+// Projections of recently shown frames, so looping playback reuses them.
+// The least recently used entries are dropped beyond maxBytes.
+class ProjectionCache {
+public:
+    explicit ProjectionCache(size_t maxBytes = 256u << 20) : m_maxBytes(maxBytes) {}
+
+    // Projection of `frame` with every available slice folded in (slices as for
+    // UpdateCrossSection). Rows are reduced in parallel with SSE2 where available;
+    // 16-bit gray is reduced per sample, everything else per byte.
+    // Returns nullptr if no slice has the frame yet.
+    const Projection* update(ProjectionOp op, int frame,
+                             const std::vector<const unsigned char*>& slices,
+                             int width, int height, PixelFormat format, int numThreads);
+    void clear() { m_entries.clear(); }
+
+private:
+    std::list<Projection> m_entries;            // Most recently used first
+    size_t m_maxBytes;
+};
+
+#endif // VOLUME_VIEWS_H
@@ -0,0 +1,389 @@
+// Lazy z-slice loading implementation
+
+#include "z_slice_loader.h"
+#include "histogram.h"
+#include "file_io.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+void ZSliceLoader::start(ImageCollection& images, int shrinkFactor, int nthFrame, size_t memoryBudget,
+                         int ioThreads) {
+    stop();
+
+    m_images = &images;
+    m_shrinkFactor = shrinkFactor;
+    m_nthFrame = std::max(1, nthFrame);
+    m_memoryBudget = memoryBudget;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_images->zFrames.resize(m_images->zAllFiles.size());
+        m_slices.assign(m_images->zAllFiles.size(), Slice());
+        m_focus = m_images->currentZIndex;
+        m_urgent = -1;
+        m_stopping = false;
+        m_readAhead = 0;
+        // Enough read files queued to keep every pool thread decoding
+        m_readAheadLimit = (size_t)SharedThreadPool().size() * 2;
+    }
+
+    // Read threads block on I/O, so they are not pool tasks
+    for (int t = 0; t < ioThreads; t++) {
+        m_readers.emplace_back([this]() { readLoop(); });
+    }
+}
+
+void ZSliceLoader::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_changed.notify_all();
+    m_readable.notify_all();
+    for (auto& reader : m_readers) {
+        reader.join();
+    }
+    m_readers.clear();
+    m_tasks.wait();                 // Queued tasks return at once while stopping
+
+    // Frames decoded for slices that never completed
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (int z = 0; z < (int)m_slices.size(); ++z) {
+        if (m_slices[z].state == SliceState::Loading) {
+            discardPending(z);
+        }
+    }
+}
+
+bool ZSliceLoader::load(int z, ProgressCallback progressCallback) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (z < 0 || z >= (int)m_slices.size()) return false;
+
+    Slice& slice = m_slices[z];
+    if (slice.state == SliceState::Resident) return true;
+
+    // Decode tasks take this slice's frames first; report progress from here
+    m_urgent = z;
+    if (slice.state != SliceState::Loading || slice.cancelled) {
+        schedule(z);
+    }
+
+    size_t reported = 0;
+    while (slice.state == SliceState::Loading && !g_interrupted.load()) {
+        m_changed.wait_for(lock, std::chrono::milliseconds(100));
+        if (progressCallback && slice.state == SliceState::Loading && slice.done != reported) {
+            reported = slice.done;
+            int total = (int)slice.files.size();
+            lock.unlock();
+            progressCallback((int)reported, total);
+            lock.lock();
+        }
+    }
+    m_urgent = -1;
+
+    if (slice.state == SliceState::Resident && progressCallback && reported != slice.files.size()) {
+        int total = (int)slice.files.size();
+        lock.unlock();
+        progressCallback(total, total);
+        lock.lock();
+    }
+    return slice.state == SliceState::Resident;
+}
+
+void ZSliceLoader::setFocus(int z) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (z < 0 || z >= (int)m_slices.size()) return;
+    m_focus = z;
+
+    std::vector<bool> wanted(m_slices.size(), false);
+    for (int w : wantedSlices()) {
+        wanted[w] = true;
+    }
+
+    // Evict slices outside the budget around the new focus, and stop loading them
+    for (int i = 0; i < (int)m_slices.size(); ++i) {
+        Slice& slice = m_slices[i];
+        if (wanted[i] || i == z) continue;
+        if (slice.state == SliceState::Resident) {
+            freeSlice(i);
+        } else if (slice.state == SliceState::Loading && !slice.cancelled) {
+            slice.cancelled = true;
+            if (slice.inFlight == 0) {
+                discardPending(i);
+            }
+        }
+    }
+
+    // Queue the frames of every wanted slice that is not resident yet
+    for (int w : wantedSlices()) {
+        Slice& slice = m_slices[w];
+        if (slice.state == SliceState::Empty ||
+            (slice.state == SliceState::Loading && slice.cancelled)) {
+            schedule(w);
+        }
+    }
+}
+
+bool ZSliceLoader::isResident(int z) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return z >= 0 && z < (int)m_slices.size() && m_slices[z].state == SliceState::Resident;
+}
+
+int ZSliceLoader::residentCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return (int)std::count_if(m_slices.begin(), m_slices.end(),
+        [](const Slice& slice) { return slice.state == SliceState::Resident; });
+}
+
+size_t ZSliceLoader::residentBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t bytes = 0;
+    for (int z = 0; z < (int)m_slices.size(); ++z) {
+        if (m_slices[z].state == SliceState::Resident) {
+            bytes += m_images->zFrames[z].size() * FrameBufferFootprint(m_images->frameBytes());
+        }
+    }
+    return bytes;
+}
+
+// Hand the slice's remaining frames to the read threads, or without them put them on
+// the shared pool (one task per frame); the displayed slice's at interactive priority
+void ZSliceLoader::schedule(int z) {
+    Slice& slice = m_slices[z];
+    size_t remaining = 0;
+
+    if (slice.state == SliceState::Loading) {
+        // Loading was cancelled but the slice is wanted again: pick up where it stopped
+        slice.cancelled = false;
+        remaining = slice.files.size() - slice.nextFrame;
+    } else {
+        slice = Slice();
+        slice.state = SliceState::Loading;
+        slice.files = previewFiles(z);
+        slice.pending.assign(slice.files.size(), ImageFrame());
+        remaining = slice.files.size();
+        if (slice.files.empty()) {
+            finishSlice(z);
+            return;
+        }
+    }
+
+    if (!m_readers.empty()) {
+        m_readable.notify_all();
+        return;
+    }
+    TaskPriority priority = (z == m_urgent || z == m_focus) ? TaskPriority::Interactive : TaskPriority::Loading;
+    for (size_t i = 0; i < remaining; ++i) {
+        m_tasks.run([this]() { readNext(); }, priority);
+    }
+}
+
+bool ZSliceLoader::claimFrame(int& z, size_t& i) {
+    if (m_stopping || g_interrupted.load()) return false;
+    z = nextSlice();
+    if (z < 0) return false;
+
+    Slice& slice = m_slices[z];
+    i = slice.nextFrame++;
+    slice.inFlight++;
+    m_readAhead++;
+    return true;
+}
+
+void ZSliceLoader::readLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        int z = -1;
+        size_t i = 0;
+        m_readable.wait(lock, [&]() {
+            return m_stopping || (m_readAhead < m_readAheadLimit && claimFrame(z, i));
+        });
+        if (z < 0) return;          // Stopping
+
+        std::string file = m_slices[z].files[i];
+        TaskPriority priority = (z == m_urgent || z == m_focus) ? TaskPriority::Interactive : TaskPriority::Loading;
+        lock.unlock();
+
+        auto contents = std::make_shared<std::vector<unsigned char>>();
+        bool ok = ReadFileContents(file, *contents);
+        m_tasks.run([this, z, i, contents, ok]() { decodeFrame(z, i, *contents, ok); }, priority);
+        lock.lock();
+    }
+}
+
+void ZSliceLoader::readNext() {
+    int z;
+    size_t i;
+    std::string file;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!claimFrame(z, i)) return;
+        file = m_slices[z].files[i];
+    }
+    std::vector<unsigned char> contents;
+    bool ok = ReadFileContents(file, contents);
+    decodeFrame(z, i, contents, ok);
+}
+
+// Decode frame i of slice z from its file contents
+void ZSliceLoader::decodeFrame(int z, size_t i, const std::vector<unsigned char>& contents, bool readOk) {
+    std::string file;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping || g_interrupted.load()) {
+            // stop() discards the slices still loading
+            m_readAhead--;
+            m_slices[z].inFlight--;
+            return;
+        }
+        file = m_slices[z].files[i];
+    }
+
+    int w = 0, h = 0;
+    unsigned char* data = nullptr;
+    if (readOk) {
+        data = DecodeAndShrinkImage(contents.data(), contents.size(), file, m_shrinkFactor, w, h,
+                                    true,   // rgbOutput
+                                    false,  // flipVertical
+                                    m_images->pixelFormat);
+    }
+    std::shared_ptr<const Histogram> histogram = ComputeHistogram(data, (size_t)w * h, m_images->pixelFormat);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_readAhead--;
+    m_readable.notify_one();
+    Slice& slice = m_slices[z];
+    slice.inFlight--;
+    slice.done++;
+
+    if (data) {
+        // Extract just the filename from path
+        size_t lastSlash = file.find_last_of("/\\");
+        std::string filename = (lastSlash != std::string::npos) ? file.substr(lastSlash + 1) : file;
+
+        slice.pending[i].filename = filename;
+        slice.pending[i].index = ExtractIndex(filename);
+        slice.pending[i].data = data;
+        slice.pending[i].histogram = std::move(histogram);
+        if (slice.width == 0) {
+            slice.width = w;
+            slice.height = h;
+        }
+    }
+
+    if (slice.cancelled) {
+        if (slice.inFlight == 0) {
+            discardPending(z);
+        }
+    } else if (slice.done == slice.files.size()) {
+        finishSlice(z);
+    }
+    m_changed.notify_all();
+}
+
+// The slice load() waits for, then the loading slice nearest to the focus
+int ZSliceLoader::nextSlice() const {
+    int best = -1;
+    for (int z = 0; z < (int)m_slices.size(); ++z) {
+        const Slice& slice = m_slices[z];
+        if (slice.state != SliceState::Loading || slice.cancelled ||
+            slice.nextFrame >= slice.files.size()) {
+            continue;
+        }
+        if (z == m_urgent) return z;
+        if (best < 0 || std::abs(z - m_focus) < std::abs(best - m_focus)) {
+            best = z;
+        }
+    }
+    return best;
+}
+
+void ZSliceLoader::finishSlice(int z) {
+    Slice& slice = m_slices[z];
+
+    // Remove failed loads and sort by index
+    std::vector<ImageFrame> frames;
+    for (auto& frame : slice.pending) {
+        if (frame.data) frames.push_back(frame);
+    }
+    slice.pending.clear();
+    std::sort(frames.begin(), frames.end(),
+        [](const ImageFrame& a, const ImageFrame& b) { return a.index < b.index; });
+
+    bool success = !frames.empty();
+    if (success && m_images->imageWidth == 0) {
+        // First slice: its preview size applies to the whole volume
+        m_images->imageWidth = slice.width;
+        m_images->imageHeight = slice.height;
+        m_images->originalImageWidth = slice.width * m_shrinkFactor;
+        m_images->originalImageHeight = slice.height * m_shrinkFactor;
+    } else if (success && (slice.width != m_images->imageWidth || slice.height != m_images->imageHeight)) {
+        std::cerr << "z" << m_images->zHeights[z] << ": preview size " << slice.width << " x " << slice.height
+                  << " differs from " << m_images->imageWidth << " x " << m_images->imageHeight
+                  << ", skipping slice" << std::endl;
+        success = false;
+    }
+
+    if (success) {
+        m_images->zFrames[z] = std::move(frames);
+        slice.state = SliceState::Resident;
+    } else {
+        for (auto& frame : frames) {
+            FreeFrameBuffer(frame.data);
+        }
+        slice.state = SliceState::Failed;
+    }
+}
+
+void ZSliceLoader::discardPending(int z) {
+    Slice& slice = m_slices[z];
+    for (auto& frame : slice.pending) {
+        FreeFrameBuffer(frame.data);
+    }
+    slice = Slice();
+}
+
+// Every n-th file plus the last one, as in 2D mode
+std::vector<std::string> ZSliceLoader::previewFiles(int z) const {
+    return m_images->zAllFiles[z].previewPaths(m_nthFrame);
+}
+
+size_t ZSliceLoader::sliceBytes(int z) const {
+    return m_images->zAllFiles[z].previewCount(m_nthFrame) * FrameBufferFootprint(m_images->frameBytes());
+}
+
+std::vector<int> ZSliceLoader::wantedSlices() const {
+    std::vector<int> wanted;
+    int count = (int)m_slices.size();
+    if (count == 0) return wanted;
+
+    // Outward from the focus: z, z+1, z-1, z+2, z-2, ...
+    std::vector<int> order = {m_focus};
+    for (int d = 1; d < count; ++d) {
+        if (m_focus + d < count) order.push_back(m_focus + d);
+        if (m_focus - d >= 0) order.push_back(m_focus - d);
+    }
+
+    // The focus is always wanted, the rest while they fit the budget
+    size_t total = 0;
+    for (int z : order) {
+        size_t bytes = sliceBytes(z);
+        if (!wanted.empty() && m_memoryBudget > 0 && total + bytes > m_memoryBudget) {
+            break;
+        }
+        total += bytes;
+        wanted.push_back(z);
+    }
+    return wanted;
+}
+
+void ZSliceLoader::freeSlice(int z) {
+    for (auto& frame : m_images->zFrames[z]) {
+        FreeFrameBuffer(frame.data);
+    }
+    m_images->zFrames[z].clear();
+    m_images->zFrames[z].shrink_to_fit();
+    m_slices[z] = Slice();
+}
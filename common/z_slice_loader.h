@@ -0,0 +1,91 @@
+// Lazy z-slice loading for PNG Image Viewer (3D mode)
+// The displayed z-slice is loaded on demand, neighbouring slices are prefetched
+// in the background outward from it and far slices are evicted under a memory budget.
+// Read threads take the most urgent (z, frame) file, read it and queue its decode as
+// a task on the shared thread pool, so slices load concurrently without a barrier
+// per z-folder and pool tasks never wait for I/O; frames of the displayed slice are
+// decoded at interactive priority, prefetching at loading priority.
+
+#ifndef Z_SLICE_LOADER_H
+#define Z_SLICE_LOADER_H
+
+#include "frame_types.h"
+#include "image_loader.h"
+#include "thread_pool.h"
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+class ZSliceLoader {
+public:
+    ZSliceLoader() = default;
+    ~ZSliceLoader() { stop(); }
+
+    // images.zAllFiles and images.pixelFormat must be set; images.zFrames is sized to match and
+    // filled as slices become resident. memoryBudget is in bytes (0 = no limit). ioThreads
+    // threads read the files (0 = the decode tasks read for themselves); slices are
+    // decoded on the shared thread pool, which must be running.
+    void start(ImageCollection& images, int shrinkFactor, int nthFrame, size_t memoryBudget, int ioThreads);
+    void stop();                    // Cancel loading and wait for the readers and decode tasks
+
+    // Make slice z resident, moving its frames to the front of the work queue and
+    // waiting for them. progressCallback runs on the calling thread.
+    // The first slice loaded sets the preview size.
+    bool load(int z, ProgressCallback progressCallback = nullptr);
+
+    // Centre prefetching on z and free resident slices that no longer fit the budget.
+    // Must be called from the thread that displays frames (evicted data is deleted here).
+    void setFocus(int z);
+
+    bool isResident(int z) const;
+    int residentCount() const;
+    size_t residentBytes() const;
+
+private:
+    enum class SliceState { Empty, Loading, Resident, Failed };
+
+    struct Slice {
+        SliceState state = SliceState::Empty;
+        std::vector<std::string> files;     // Preview files (every n-th)
+        std::vector<ImageFrame> pending;    // Decoded frames while loading
+        size_t nextFrame = 0;               // Next file to read
+        size_t inFlight = 0;                // Files being read or decoded
+        size_t done = 0;                    // Files finished (decoded or failed)
+        int width = 0, height = 0;          // Preview size of the first decoded frame
+        bool cancelled = false;             // Left the budget while loading
+    };
+
+    void schedule(int z);                   // m_mutex held
+    bool claimFrame(int& z, size_t& i);     // Take the most urgent unread frame (m_mutex held)
+    void readLoop();                        // Read thread: read claimed frames, queue their decodes
+    void readNext();                        // Pool task without read threads: read and decode one frame
+    void decodeFrame(int z, size_t i, const std::vector<unsigned char>& contents, bool readOk);
+    int nextSlice() const;                  // m_mutex held
+    void finishSlice(int z);                // m_mutex held
+    void discardPending(int z);             // m_mutex held
+    std::vector<std::string> previewFiles(int z) const;
+    size_t sliceBytes(int z) const;
+    std::vector<int> wantedSlices() const;  // Nearest slices that fit the budget (m_mutex held)
+    void freeSlice(int z);                  // m_mutex held
+
+    ImageCollection* m_images = nullptr;
+    int m_shrinkFactor = 1;
+    int m_nthFrame = 1;
+    size_t m_memoryBudget = 0;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::condition_variable m_readable;     // Readers: frames to read, or room to read ahead
+    std::vector<Slice> m_slices;
+    int m_focus = 0;
+    int m_urgent = -1;                      // Slice being waited for by load()
+    bool m_stopping = false;
+    size_t m_readAhead = 0;                 // Frames read (or being read) but not decoded yet
+    size_t m_readAheadLimit = 0;
+    std::vector<std::thread> m_readers;
+    TaskGroup m_tasks{SharedThreadPool(), TaskPriority::Loading};
+};
+
+#endif // Z_SLICE_LOADER_H
@@ -0,0 +1,165 @@
+// Decode benchmark for PNG Image Viewer
+// Decodes every PNG of a folder from memory with stb_image and with the compiled-in
+// PNG decoder backend, checks that both give the same pixels, and reports throughput.
+// With a shrink factor above 1 it also times the preview path: stb_image followed by
+// the shrink loop against the backend's fused decode-and-shrink.
+//
+// Usage: ./decode_bench <folder> [repeats] [shrink]
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../common/stb_image.h"
+#include "../common/png_decoder.h"
+#include "../common/file_io.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <dirent.h>
+
+// Same nearest-pixel shrink as DecodeAndShrinkImage (RGB, not flipped)
+static unsigned char* Shrink(const unsigned char* data, int w, int h, int shrink, int& newW, int& newH) {
+    newW = w / shrink;
+    newH = h / shrink;
+    unsigned char* out = new unsigned char[(size_t)newW * newH * 3];
+    for (int y = 0; y < newH; y++) {
+        for (int x = 0; x < newW; x++) {
+            const unsigned char* src = data + ((size_t)y * shrink * w + (size_t)x * shrink) * 3;
+            unsigned char* dst = out + ((size_t)y * newW + x) * 3;
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
+    return out;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <folder> [repeats] [shrink]" << std::endl;
+        return 1;
+    }
+    std::string folder = argv[1];
+    int repeats = argc > 2 ? std::max(1, atoi(argv[2])) : 3;
+    int shrink = argc > 3 ? std::max(1, atoi(argv[3])) : 1;
+
+    // Read all files up front so only decoding is timed
+    std::vector<std::string> names;
+    DIR* dir = opendir(folder.c_str());
+    if (!dir) {
+        std::cerr << "Could not open directory: " << folder << std::endl;
+        return 1;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        size_t length = strlen(entry->d_name);
+        if (length > 4 && memcmp(entry->d_name + length - 4, ".png", 4) == 0) {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+
+    std::vector<std::vector<unsigned char>> files(names.size());
+    size_t compressedBytes = 0;
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (!ReadFileContents(folder + "/" + names[i], files[i])) return 1;
+        compressedBytes += files[i].size();
+    }
+    if (files.empty()) {
+        std::cerr << "No PNG files in " << folder << std::endl;
+        return 1;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto secondsSince = [](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+    size_t pixelBytes = 0;
+    size_t fallbacks = 0;
+    size_t mismatches = 0;
+    double stbSeconds = 0.0, backendSeconds = 0.0;
+    double stbShrinkSeconds = 0.0, fusedSeconds = 0.0;
+
+    for (int r = 0; r < repeats; ++r) {
+        for (size_t i = 0; i < files.size(); ++i) {
+            int w1, h1, channels, w2 = 0, h2 = 0;
+            auto start = Clock::now();
+            unsigned char* reference = stbi_load_from_memory(files[i].data(), (int)files[i].size(), &w1, &h1, &channels, 3);
+            stbSeconds += secondsSince(start);
+
+            start = Clock::now();
+            unsigned char* decoded = DecodePNG(files[i].data(), files[i].size(), w2, h2);
+            backendSeconds += secondsSince(start);
+
+            if (r == 0) {
+                if (!decoded) {
+                    fallbacks++;
+                } else if (!reference || w1 != w2 || h1 != h2 ||
+                           memcmp(reference, decoded, (size_t)w1 * h1 * 3) != 0) {
+                    std::cerr << "Mismatch: " << names[i] << std::endl;
+                    mismatches++;
+                }
+            }
+
+            // Images smaller than the shrink factor are left to the full-size path
+            if (shrink > 1 && decoded && w2 >= shrink && h2 >= shrink) {
+                int sw1, sh1, sw2 = 0, sh2 = 0;
+                start = Clock::now();
+                unsigned char* full = stbi_load_from_memory(files[i].data(), (int)files[i].size(), &w1, &h1, &channels, 3);
+                unsigned char* expected = Shrink(full, w1, h1, shrink, sw1, sh1);
+                stbi_image_free(full);
+                stbShrinkSeconds += secondsSince(start);
+
+                start = Clock::now();
+                unsigned char* shrunk = DecodePNGShrunk(files[i].data(), files[i].size(), shrink, PixelFormat::RGB8,
+                                                        true, false, sw2, sh2);
+                fusedSeconds += secondsSince(start);
+
+                if (r == 0 && (!shrunk || sw1 != sw2 || sh1 != sh2 ||
+                               memcmp(expected, shrunk, (size_t)sw1 * sh1 * 3) != 0)) {
+                    std::cerr << "Shrink mismatch: " << names[i] << std::endl;
+                    mismatches++;
+                }
+                delete[] expected;
+                FreeFrameBuffer(shrunk);
+            }
+            if (reference) pixelBytes += (size_t)w1 * h1 * 3;
+            stbi_image_free(reference);
+            free(decoded);
+        }
+    }
+
+    double mb = pixelBytes / (1024.0 * 1024.0);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << files.size() << " files, " << (compressedBytes / (1024.0 * 1024.0)) << " MB compressed, "
+              << repeats << " repeats" << std::endl;
+    std::cout << "  stb_image      : " << (mb / stbSeconds) << " MB/s" << std::endl;
+    if (fallbacks == files.size()) {
+        std::cout << "  " << PngDecoderName() << " backend handled none of the files" << std::endl;
+        return 0;
+    }
+    std::cout << "  " << std::left << std::setw(15) << PngDecoderName() << ": " << (mb / backendSeconds)
+              << " MB/s (" << std::setprecision(2) << (stbSeconds / backendSeconds) << "x)" << std::endl;
+    if (shrink > 1) {
+        // Throughput in full-size pixels, so the lines are comparable
+        std::string fused = std::string(PngDecoderName()) + " fused";
+        std::cout << std::setprecision(1)
+                  << "  shrink " << shrink << ":" << std::endl
+                  << "    stb + shrink   : " << (mb / stbShrinkSeconds) << " MB/s" << std::endl
+                  << "    " << std::setw(15) << fused << ": " << (mb / fusedSeconds) << " MB/s ("
+                  << std::setprecision(2) << (stbShrinkSeconds / fusedSeconds) << "x)" << std::endl;
+    }
+    if (fallbacks > 0) {
+        std::cout << "  " << fallbacks << " file(s) not handled by the backend (decoded by stb_image in the viewer)" << std::endl;
+    }
+    if (mismatches > 0) {
+        std::cout << "  " << mismatches << " file(s) decoded differently!" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -7,6 +7,15 @@
 #include "../common/frame_types.h"
 #include "../common/math_utils.h"
 #include "../common/image_loader.h"
+#include "../common/video_export.h"
+#include "../common/z_slice_loader.h"
+#include "../common/volume_views.h"
+#include "../common/color_lut.h"
+#include "../common/histogram.h"
+#include "../common/frame_store.h"
+#include "../common/cpu_topology.h"
+#include "../common/thread_pool.h"
+#include "folder_watcher.h"
 
 #include <SDL2/SDL.h>
 #include <iostream>
@@ -18,78 +27,27 @@
 #include <cstdlib>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <chrono>
 #include <csignal>
 #include <cstdio>
 #include <iomanip>
+#include <thread>
+#include <sstream>
 #include <limits>
 #include <map>
 #include <condition_variable>
 #include <atomic>
-#include <thread>
 
-// Multi-threaded MP4 export using ffmpeg (forward declaration)
-void ExportToMP4_MT();
+// Multi-threaded export in the background (forward declarations)
+void QueueExport();
+void InstallExportCallbacks();
+int RunBatchExport();
 
 // Forward declarations
 bool CreateTexture();
 bool SwitchToZHeight(int newZIndex);
 
-// Helper: render current view into RGB24 buffer using full-resolution image
-static void RenderViewToBufferHQ(
-    unsigned char* buffer,
-    int outW,
-    int outH,
-    const unsigned char* src,
-    int srcW,
-    int srcH,
-    const ViewState& view,
-    const AppSettings& settings,
-    int displayedImageW,
-    int displayedImageH
-) {
-    // BUG FIX: Scale view parameters from displayed (shrunk) image to full-res image
-    // The view.panX/panY are in displayed image coordinates, need to scale to full-res
-    double scaleFactor = (double)srcW / displayedImageW;
-    
-    ViewState scaledView = view;
-    scaledView.panX *= scaleFactor;
-    scaledView.panY *= scaleFactor;
-    
-    // Use the same math as the preview (RenderFrame), but with full-res dimensions
-    RenderParams params = CalculateRenderParams(scaledView, settings, srcW, srcH);
-    // params.srcX, srcY, srcW, srcH: region in source image
-    // params.dstX, dstY, dstW, dstH: region in output buffer
-
-    // For each output pixel, map to source pixel using srcRect/dstRect
-    for (int y = 0; y < outH; ++y) {
-        for (int x = 0; x < outW; ++x) {
-            // Only fill pixels inside the destination rectangle
-            if (x >= params.dstX && x < params.dstX + params.dstW &&
-                y >= params.dstY && y < params.dstY + params.dstH) {
-                // Map (x, y) in output to (sx, sy) in source
-                double fx = (x - params.dstX) / (double)params.dstW;
-                double fy = (y - params.dstY) / (double)params.dstH;
-                int sx = params.srcX + static_cast<int>(fx * params.srcW);
-                int sy = params.srcY + static_cast<int>(fy * params.srcH);
-                unsigned char* dst = buffer + (static_cast<size_t>(y) * outW + x) * 3;
-                if (sx >= 0 && sx < srcW && sy >= 0 && sy < srcH) {
-                    const unsigned char* srcPix = src + (static_cast<size_t>(sy) * srcW + sx) * 3;
-                    dst[0] = srcPix[0];
-                    dst[1] = srcPix[1];
-                    dst[2] = srcPix[2];
-                } else {
-                    dst[0] = dst[1] = dst[2] = 0;
-                }
-            } else {
-                // Outside the destination rectangle: black
-                unsigned char* dst = buffer + (static_cast<size_t>(y) * outW + x) * 3;
-                dst[0] = dst[1] = dst[2] = 0;
-            }
-        }
-    }
-}
-
 // Signal handler for Ctrl+C
 void signalHandler(int signum) {
     g_interrupted.store(true);
@@ -100,40 +58,83 @@ AppSettings g_settings;
 ViewState g_view;
 ImageCollection g_images;
 
+// Background exports (S queues the current view, C cancels)
+ExportQueue g_exportQueue;
+
+// 3D mode: loads z-slices on demand and prefetches their neighbours
+ZSliceLoader g_zLoader;
+
 // SDL resources
 SDL_Window* g_window = nullptr;
 SDL_Renderer* g_renderer = nullptr;
 SDL_Texture* g_texture = nullptr;
 
-// Find all PNG files in a directory
-std::vector<std::string> FindPngFiles(const std::string& directory) {
-    std::vector<std::string> files;
+// 3D mode: XZ/YZ cross-section of the current frame and its texture
+CrossSection g_crossSection;
+SDL_Texture* g_sectionTexture = nullptr;
+int g_sectionTextureWidth = 0;
+int g_sectionTextureHeight = 0;
+
+// 3D mode: projections over z of recently shown frames
+ProjectionCache g_projections;
+
+// 2D watch mode: frames written to the folder after loading
+FolderWatcher g_watcher;
+
+// Expands single-channel previews to RGB right before the texture upload
+ColorLut g_colorLut;
+int g_colorLutMap = -1;             // Colormap and levels window g_colorLut was built for
+double g_colorLutLow = 0.0;
+double g_colorLutHigh = 1.0;
+std::vector<unsigned char> g_displayRGB;
+
+// Unpacked copies of the last frames drawn when previews are compressed
+FrameCache g_frameCache;
+
+// Built-in colormaps, followed by the --colormap file if one was given
+std::vector<Colormap> g_colormaps;
+
+// Check a directory entry's type from d_type, falling back to stat() only when the
+// file system does not report it (DT_UNKNOWN) or the entry is a symlink
+bool EntryIsType(const std::string& directory, const struct dirent* entry, mode_t type,
+                 std::atomic<size_t>* statCalls) {
+    if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK) {
+        return (type == S_IFREG) ? entry->d_type == DT_REG : entry->d_type == DT_DIR;
+    }
+    if (statCalls) (*statCalls)++;
+    std::string fullPath = directory + "/" + entry->d_name;
+    struct stat st;
+    return stat(fullPath.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == type;
+}
+
+// Add all PNG files of a directory that match *_<number>.png to the table (one
+// directory read, no per-file stat on file systems that report entry types).
+// Returns the number of PNG files seen, matching or not.
+size_t FindPngFiles(FileTable& table, std::atomic<size_t>* statCalls = nullptr) {
+    const std::string& directory = table.folder();
+    size_t pngCount = 0;
     
     DIR* dir = opendir(directory.c_str());
     if (!dir) {
         std::cerr << "Could not open directory: " << directory << std::endl;
-        return files;
+        return 0;
     }
     
     struct dirent* entry;
     while ((entry = readdir(dir)) != nullptr) {
-        std::string name = entry->d_name;
+        const char* name = entry->d_name;
+        size_t length = strlen(name);
         
-        // Skip . and ..
-        if (name == "." || name == "..") continue;
-        
-        // Check if it's a .png file
-        if (name.size() > 4 && name.substr(name.size() - 4) == ".png") {
-            std::string fullPath = directory + "/" + name;
-            struct stat st;
-            if (stat(fullPath.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
-                files.push_back(name);
-            }
+        // Check if it's a .png file (this also skips . and ..)
+        if (length > 4 && memcmp(name + length - 4, ".png", 4) == 0 &&
+            EntryIsType(directory, entry, S_IFREG, statCalls)) {
+            pngCount++;
+            table.add(name, length);
         }
     }
     
     closedir(dir);
-    return files;
+    return pngCount;
 }
 
 // Find all z-folders (z<number>) in a directory for 3D mode
@@ -155,9 +156,7 @@ std::vector<std::pair<int, std::string>> FindZFolders(const std::string& directo
         
         // Check if it starts with 'z' and is a directory
         if (name.size() > 1 && name[0] == 'z') {
-            std::string fullPath = directory + "/" + name;
-            struct stat st;
-            if (stat(fullPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            if (EntryIsType(directory, entry, S_IFDIR, nullptr)) {
                 // Extract the number after 'z'
                 try {
                     int zHeight = std::stoi(name.substr(1));
@@ -182,51 +181,47 @@ std::vector<std::pair<int, std::string>> FindZFolders(const std::string& directo
 bool LoadImagesFromFolder(const std::string& folder) {
     int shrinkFactor = g_settings.shrinkFactor;
     
-    // Find all PNG files
-    std::vector<std::string> allFiles = FindPngFiles(folder);
-    
-    // Filter and sort by index
-    std::vector<std::pair<std::string, int>> validFiles;
-    for (const auto& file : allFiles) {
-        int idx = ExtractIndex(file);
-        if (idx >= 0) {
-            validFiles.push_back({file, idx});
-        }
-    }
-    
-    // Sort by numeric index
-    std::sort(validFiles.begin(), validFiles.end(),
-        [](const auto& a, const auto& b) { return a.second < b.second; });
-    
-    if (validFiles.empty()) {
+    // Find all PNG files and sort them by numeric index
+    auto scanStart = std::chrono::steady_clock::now();
+    std::atomic<size_t> statCalls(0);
+    FileTable allFiles(folder);
+    size_t pngCount = FindPngFiles(allFiles, &statCalls);
+    allFiles.sortByIndex();
+    double scanMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scanStart).count();
+    std::cout << "Scanned " << pngCount << " PNG files in " << std::fixed << std::setprecision(1)
+              << scanMs << " ms (" << statCalls.load() << " stat calls)" << std::defaultfloat << std::setprecision(6) << std::endl;
+    
+    if (allFiles.empty()) {
         std::cerr << "No matching files found in " << folder << std::endl;
         return false;
     }
     
-    // Auto-calculate shrink factor if needed
-    if (shrinkFactor == 0) {
-        std::string probeFile = folder + "/" + validFiles[0].first;
-        shrinkFactor = AutoCalculateShrinkFactor(probeFile, g_settings.windowWidth, g_settings.windowHeight);
+    // Grayscale sequences keep one 8/16-bit channel per preview pixel
+    PixelFormat format = g_settings.forceRGB ? PixelFormat::RGB8 : ProbePixelFormat(allFiles.path(0));
+    
+    // Fit the previews into --mem-budget, or auto-calculate shrink factor if needed
+    if (g_settings.memBudgetMB > 0) {
+        size_t budget = (size_t)g_settings.memBudgetMB * 1024 * 1024;
+        FrameCompression mode = FrameCompressionAvailable(FrameCompression::LZ4) ? FrameCompression::LZ4
+                                                                                 : FrameCompression::RLE;
+        PreviewMemoryPlan plan = PlanPreviewMemory(allFiles, format, budget, shrinkFactor, g_settings.nthFrame,
+                                                   g_settings.windowWidth, g_settings.windowHeight,
+                                                   !g_settings.frameCompressionSet, mode, g_settings.keyframeInterval);
+        PrintPreviewMemoryPlan(plan, budget);
+        shrinkFactor = plan.shrinkFactor;
+        g_settings.nthFrame = plan.nthFrame;
+        if (!g_settings.frameCompressionSet) {
+            g_settings.frameCompression = plan.compression;
+        }
+    } else if (shrinkFactor == 0) {
+        shrinkFactor = AutoCalculateShrinkFactor(allFiles.path(0), g_settings.windowWidth, g_settings.windowHeight);
     }
     
     // Select every n-th file
-    std::vector<std::string> files;
-    for (size_t i = 0; i < validFiles.size(); i += g_settings.nthFrame) {
-        files.push_back(folder + "/" + validFiles[i].first);
-    }
-    // Always include last frame
-    if (!validFiles.empty() && (validFiles.size() - 1) % g_settings.nthFrame != 0) {
-        files.push_back(folder + "/" + validFiles.back().first);
-    }
-    
-    // All file paths for export
-    std::vector<std::string> allFilePaths;
-    for (const auto& vf : validFiles) {
-        allFilePaths.push_back(folder + "/" + vf.first);
-    }
+    std::vector<std::string> files = allFiles.previewPaths(g_settings.nthFrame);
     
     if (g_settings.debugMode) {
-        std::cout << "Found " << validFiles.size() << " matching images (*_<number>.png)" << std::endl;
+        std::cout << "Found " << allFiles.size() << " matching images (*_<number>.png)" << std::endl;
         if (g_settings.nthFrame > 1) {
             std::cout << "Loading every " << g_settings.nthFrame << "-th image: " << files.size() << " images" << std::endl;
         }
@@ -234,19 +229,51 @@ bool LoadImagesFromFolder(const std::string& folder) {
     
     // Load images (RGB output, no vertical flip for SDL2)
     bool success = LoadImagesCommon(
-        g_images, files, allFilePaths, folder,
-        shrinkFactor, g_settings.numThreads,
+        g_images, files, allFiles, folder,
+        shrinkFactor, g_settings.ioThreads,
         true,   // rgbOutput
-        false   // flipVertical (SDL2 is top-down like stb_image)
+        false,  // flipVertical (SDL2 is top-down like stb_image)
+        format,
+        g_settings.frameCompression, g_settings.keyframeInterval
     );
     
     if (success) {
         g_view.reset();
+        
+        if (g_settings.debugMode) {
+            std::cout << "Playback read bandwidth: " << std::fixed << std::setprecision(2)
+                      << MeasureFrameReadBandwidth(g_images.activeFrames(), g_images.frameBytes()) << " GB/s"
+                      << std::defaultfloat << std::setprecision(6) << std::endl;
+        }
+        
+        // Watch the folder for frames written from now on
+        if (g_settings.watchFolder &&
+            g_watcher.start(g_images.allFiles, shrinkFactor, g_settings.nthFrame, g_images.imageWidth, g_images.imageHeight,
+                            g_images.pixelFormat, g_settings.frameCompression)) {
+            std::cout << "Watching " << folder << " for new frames"
+                      << (g_settings.watchFollow ? " (following)" : "") << std::endl;
+        }
     }
     
     return success;
 }
 
+// Memory for resident z-slices (--z-cache, else --mem-budget, default: half of physical RAM)
+size_t ZCacheBudgetBytes() {
+    if (g_settings.zCacheMB > 0) {
+        return (size_t)g_settings.zCacheMB * 1024 * 1024;
+    }
+    if (g_settings.memBudgetMB > 0) {
+        return (size_t)g_settings.memBudgetMB * 1024 * 1024;
+    }
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages <= 0 || pageSize <= 0) {
+        return 0;
+    }
+    return (size_t)pages * pageSize / 2;
+}
+
 // Load images from z-folders (3D mode - folder contains z<number> subfolders)
 bool LoadImagesFrom3DFolder(const std::string& baseFolder) {
     int shrinkFactor = g_settings.shrinkFactor;
@@ -261,10 +288,13 @@ bool LoadImagesFrom3DFolder(const std::string& baseFolder) {
     if (g_settings.debugMode) {
         std::cout << "Found " << zFolders.size() << " z-folders (3D mode)" << std::endl;
     }
+    if (g_settings.watchFolder) {
+        std::cerr << "--watch is only supported in 2D mode, ignoring it" << std::endl;
+    }
     
     // Store z-heights
     g_images.zHeights.clear();
-    g_images.zAllFilePaths.clear();
+    g_images.zAllFiles.clear();
     for (const auto& [zHeight, folderName] : zFolders) {
         g_images.zHeights.push_back(zHeight);
     }
@@ -286,63 +316,103 @@ bool LoadImagesFrom3DFolder(const std::string& baseFolder) {
     if (g_settings.debugMode) {
         std::cout << "Scanning all z-folders for file lists..." << std::endl;
     }
-    for (size_t zIdx = 0; zIdx < zFolders.size(); ++zIdx) {
-        std::string folder = baseFolder + "/" + zFolders[zIdx].second;
-        std::vector<std::string> allFiles = FindPngFiles(folder);
-        
-        if (g_settings.debugMode) {
-            std::cout << "  z" << g_images.zHeights[zIdx] << " (" << folder << "): " 
-                      << allFiles.size() << " PNG files";
+    // z-folders are scanned in parallel; on network file systems the directory
+    // reads dominate and overlap well. The scans block on I/O, so they run on
+    // dedicated threads (--io-threads of them) rather than on the shared pool.
+    auto scanStart = std::chrono::steady_clock::now();
+    std::atomic<size_t> statCalls(0);
+    std::atomic<size_t> nextFolder(0);
+    std::vector<size_t> pngCounts(zFolders.size(), 0);
+    g_images.zAllFiles.assign(zFolders.size(), FileTable());
+    
+    auto scanWorker = [&]() {
+        for (size_t zIdx = nextFolder++; zIdx < zFolders.size(); zIdx = nextFolder++) {
+            // Matching files sorted by index, stored for this z-height
+            FileTable& zFiles = g_images.zAllFiles[zIdx];
+            zFiles = FileTable(baseFolder + "/" + zFolders[zIdx].second);
+            pngCounts[zIdx] = FindPngFiles(zFiles, &statCalls);
+            zFiles.sortByIndex();
         }
-        
-        // Filter and sort by index
-        std::vector<std::pair<std::string, int>> validFiles;
-        for (const auto& file : allFiles) {
-            int idx = ExtractIndex(file);
-            if (idx >= 0) {
-                validFiles.push_back({file, idx});
-            }
-        }
-        
-        std::sort(validFiles.begin(), validFiles.end(),
-            [](const auto& a, const auto& b) { return a.second < b.second; });
-        
-        // Store all file paths for this z-height
-        std::vector<std::string> zFiles;
-        for (const auto& vf : validFiles) {
-            zFiles.push_back(folder + "/" + vf.first);
-        }
-        g_images.zAllFilePaths.push_back(zFiles);
-        
+    };
+    
+    int scanThreads = g_settings.ioThreads > 0 ? g_settings.ioThreads : g_settings.numThreads;
+    scanThreads = std::max(1, std::min(scanThreads, (int)zFolders.size()));
+    std::vector<std::thread> scanners;
+    for (int t = 0; t < scanThreads; ++t) {
+        scanners.emplace_back(scanWorker);
+    }
+    for (auto& scanner : scanners) {
+        scanner.join();
+    }
+    
+    size_t totalPng = 0;
+    for (size_t zIdx = 0; zIdx < zFolders.size(); ++zIdx) {
+        totalPng += pngCounts[zIdx];
         if (g_settings.debugMode) {
-            std::cout << " -> " << zFiles.size() << " valid files" << std::endl;
+            std::cout << "  z" << g_images.zHeights[zIdx] << " (" << baseFolder << "/" << zFolders[zIdx].second
+                      << "): " << pngCounts[zIdx] << " PNG files -> "
+                      << g_images.zAllFiles[zIdx].size() << " valid files" << std::endl;
         }
     }
+    double scanMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - scanStart).count();
+    std::cout << "Scanned " << totalPng << " PNG files in " << zFolders.size() << " z-folders in "
+              << std::fixed << std::setprecision(1) << scanMs << " ms with " << scanThreads << " threads ("
+              << statCalls.load() << " stat calls)" << std::defaultfloat << std::setprecision(6) << std::endl;
     if (g_settings.debugMode) {
-        std::cout << "Total z-heights loaded: " << g_images.zAllFilePaths.size() << std::endl;
+        std::cout << "Total z-heights loaded: " << g_images.zAllFiles.size() << std::endl;
+    }
+    
+    // Shrink factor, pixel format and preview size all come from one z-folder: the
+    // starting one, or the first with files if that is empty
+    const FileTable* probeFiles = nullptr;
+    if (g_images.currentZIndex < (int)g_images.zAllFiles.size()
+        && !g_images.zAllFiles[g_images.currentZIndex].empty()) {
+        probeFiles = &g_images.zAllFiles[g_images.currentZIndex];
+    } else {
+        for (const FileTable& files : g_images.zAllFiles) {
+            if (!files.empty()) {
+                probeFiles = &files;
+                break;
+            }
+        }
     }
     
-    // Auto-calculate shrink factor if needed
-    if (shrinkFactor == 0 && g_images.currentZIndex < (int)g_images.zAllFilePaths.size() 
-        && !g_images.zAllFilePaths[g_images.currentZIndex].empty()) {
-        shrinkFactor = AutoCalculateShrinkFactor(
-            g_images.zAllFilePaths[g_images.currentZIndex][0],
-            g_settings.windowWidth, g_settings.windowHeight);
+    // Fit the starting z-height into --mem-budget (the others share it through the
+    // z-cache), or auto-calculate shrink factor if needed
+    if (g_settings.memBudgetMB > 0 && probeFiles) {
+        const FileTable& files = *probeFiles;
+        size_t budget = (size_t)g_settings.memBudgetMB * 1024 * 1024;
+        PixelFormat format = g_settings.forceRGB ? PixelFormat::RGB8 : ProbePixelFormat(files.path(0));
+        PreviewMemoryPlan plan = PlanPreviewMemory(files, format, budget, shrinkFactor, g_settings.nthFrame,
+                                                   g_settings.windowWidth, g_settings.windowHeight,
+                                                   false, FrameCompression::Off, g_settings.keyframeInterval);
+        PrintPreviewMemoryPlan(plan, budget);
+        shrinkFactor = plan.shrinkFactor;
+        g_settings.nthFrame = plan.nthFrame;
+    } else if (shrinkFactor == 0 && probeFiles) {
+        shrinkFactor = AutoCalculateShrinkFactor(probeFiles->path(0), g_settings.windowWidth, g_settings.windowHeight);
     }
+    shrinkFactor = std::max(1, shrinkFactor);
     
     // Print loading header
     std::cout << "\nUsing " << g_settings.numThreads << " cores." << std::endl;
     std::cout << "Memory usage:" << std::endl;
     std::cout << "  Shrink factor: " << shrinkFactor << std::endl;
     
-    // Get dimensions from first image
+    // Get dimensions and pixel format from first image
     int probeW, probeH;
-    if (!g_images.zAllFilePaths.empty() && !g_images.zAllFilePaths[0].empty()) {
-        unsigned char* probeData = stbi_load(g_images.zAllFilePaths[0][0].c_str(), &probeW, &probeH, nullptr, 3);
-        if (probeData) {
-            stbi_image_free(probeData);
-            std::cout << "  Preview: " << (probeW / shrinkFactor) << " x " << (probeH / shrinkFactor) << std::endl;
+    if (probeFiles) {
+        g_images.pixelFormat = g_settings.forceRGB ? PixelFormat::RGB8 : ProbePixelFormat(probeFiles->path(0));
+        if (stbi_info(probeFiles->path(0).c_str(), &probeW, &probeH, nullptr)) {
+            std::cout << "  Preview: " << (probeW / shrinkFactor) << " x " << (probeH / shrinkFactor) << " "
+                      << PixelFormatName(g_images.pixelFormat) << std::endl;
             std::cout << "  Original: " << probeW << " x " << probeH << std::endl;
+            
+            // Known preview size lets the loader budget slices before any is decoded
+            g_images.imageWidth = probeW / shrinkFactor;
+            g_images.imageHeight = probeH / shrinkFactor;
+            g_images.originalImageWidth = g_images.imageWidth * shrinkFactor;
+            g_images.originalImageHeight = g_images.imageHeight * shrinkFactor;
         }
     }
     
@@ -350,96 +420,39 @@ bool LoadImagesFrom3DFolder(const std::string& baseFolder) {
     std::string commonPath = baseFolder;
     std::cout << "Folder: " << commonPath << std::endl;
     
-    if (g_settings.debugMode) {
-        std::cout << "\nLoading ALL z-heights into memory..." << std::endl;
+    // All z-heights that fit the cache are queued at once, nearest first; only the
+    // starting one is waited for, the others keep loading in the background
+    size_t budget = ZCacheBudgetBytes();
+    g_zLoader.start(g_images, shrinkFactor, g_settings.nthFrame, budget, g_settings.ioThreads);
+    g_zLoader.setFocus(g_images.currentZIndex);
+    
+    bool success = g_zLoader.load(g_images.currentZIndex, [](int current, int total) {
+        std::cout << "\rz" << g_images.zHeights[g_images.currentZIndex] << " - Loading: "
+                  << current << "/" << total << std::flush;
+        return true;
+    });
+    if (!success) {
+        std::cerr << (g_interrupted.load() ? " interrupted!" : " failed!") << std::endl;
+        return false;
     }
     
-    // Load all z-heights into memory
-    g_images.zFrames.resize(zFolders.size());
-    size_t totalMemory = 0;
-    size_t totalFrames = 0;
-    
-    for (size_t zIdx = 0; zIdx < zFolders.size(); ++zIdx) {
-        const std::vector<std::string>& allFilePaths = g_images.zAllFilePaths[zIdx];
-        
-        if (allFilePaths.empty()) {
-            if (g_settings.debugMode) {
-                std::cout << "  z" << g_images.zHeights[zIdx] << ": no files, skipping" << std::endl;
-            }
-            continue;
-        }
-        
-        // Select every n-th file for preview
-        std::vector<std::string> files;
-        for (size_t i = 0; i < allFilePaths.size(); i += g_settings.nthFrame) {
-            files.push_back(allFilePaths[i]);
-        }
-        if (!allFilePaths.empty() && (allFilePaths.size() - 1) % g_settings.nthFrame != 0) {
-            files.push_back(allFilePaths.back());
-        }
-        
-        // Extract folder from first file path
-        std::string currentFolder;
-        if (!allFilePaths.empty()) {
-            size_t lastSlash = allFilePaths[0].find_last_of('/');
-            if (lastSlash != std::string::npos) {
-                currentFolder = allFilePaths[0].substr(0, lastSlash);
-            }
-        }
-        
-        // Print z-height label (will be on same line as loading progress)
-        std::cout << "z" << g_images.zHeights[zIdx] << " - " << std::flush;
-        
-        // Load images into temporary collection
-        ImageCollection tempCollection;
-        bool success = LoadImagesCommon(
-            tempCollection, files, allFilePaths, currentFolder,
-            shrinkFactor, g_settings.numThreads,
-            true,   // rgbOutput
-            false,  // flipVertical
-            nullptr, // progressCallback
-            true    // quietMode - suppress verbose output
-        );
-        
-        if (success) {
-            // Store dimensions from first z-height FIRST
-            if (zIdx == 0) {
-                g_images.imageWidth = tempCollection.imageWidth;
-                g_images.imageHeight = tempCollection.imageHeight;
-                g_images.originalImageWidth = tempCollection.originalImageWidth;
-                g_images.originalImageHeight = tempCollection.originalImageHeight;
-            }
-            
-            // Move frames to zFrames
-            g_images.zFrames[zIdx] = std::move(tempCollection.frames);
-            size_t zMem = g_images.zFrames[zIdx].size() * g_images.imageWidth * g_images.imageHeight * 3;
-            totalMemory += zMem;
-            totalFrames += g_images.zFrames[zIdx].size();
-            
-            // Print RAM info on the same line after the progress completes
-            std::cout << " - RAM: " << (zMem / (1024.0 * 1024.0 * 1024.0)) << " GB (z" 
-                      << g_images.zHeights[zIdx] << ")" << std::endl;
-            
-        } else {
-            std::cerr << "failed!" << std::endl;
-            return false;
-        }
+    size_t zMem = g_images.zFrames[g_images.currentZIndex].size() * g_images.frameBytes();
+    std::cout << " - RAM: " << (zMem / (1024.0 * 1024.0 * 1024.0)) << " GB (z" 
+              << g_images.zHeights[g_images.currentZIndex] << ")" << std::endl;
+    std::cout << "Prefetching other z-heights in the background (cache: ";
+    if (budget > 0) {
+        std::cout << (budget / (1024.0 * 1024.0 * 1024.0)) << " GB)" << std::endl;
+    } else {
+        std::cout << "unlimited)" << std::endl;
     }
     
-    // Print final summary
-    std::cout << "\nLoaded " << zFolders.size() << " x " << (totalFrames / zFolders.size()) 
-              << " images for preview." << std::endl;
-    std::cout << "Total RAM usage: " << (totalMemory / (1024.0 * 1024.0 * 1024.0)) << " GB" << std::endl;
-    
-    // Set current frames to point to current z-height
-    g_images.frames = g_images.zFrames[g_images.currentZIndex];
-    g_images.allFilePaths = g_images.zAllFilePaths[g_images.currentZIndex];
+    // Frames and file paths are served from the current z-height from now on
     g_images.currentFolder = baseFolder + "/" + zFolders[g_images.currentZIndex].second;
-    g_images.using3DMode = true;  // Enable 3D mode to prevent double-free
+    g_images.using3DMode = true;
     
     if (g_settings.debugMode) {
         std::cout << "\nStarting at z" << g_images.zHeights[g_images.currentZIndex] 
-                  << " with " << g_images.frames.size() << " frames loaded" << std::endl;
+                  << " with " << g_images.size() << " frames loaded" << std::endl;
     }
     
     g_view.reset();
@@ -471,22 +484,42 @@ bool SwitchToZHeight(int newZIndex) {
     
     // Save current frame position to try to maintain it
     int savedFramePosition = g_images.currentFrame;
-    
-    // Update z-index
     int oldZIndex = g_images.currentZIndex;
-    g_images.currentZIndex = newZIndex;
     
     if (g_settings.debugMode) {
         std::cout << "Switching from z" << g_images.zHeights[oldZIndex] 
-                  << " to z" << g_images.zHeights[newZIndex] << " (instant - already in memory)" << std::endl;
+                  << " to z" << g_images.zHeights[newZIndex]
+                  << (g_zLoader.isResident(newZIndex) ? " (instant - already in memory)" : " (loading)") << std::endl;
+    }
+    
+    // Slices that have not been prefetched yet are loaded now
+    if (!g_zLoader.isResident(newZIndex)) {
+        std::cout << "z" << g_images.zHeights[newZIndex] << " not prefetched yet, loading..." << std::endl;
+        bool loaded = g_zLoader.load(newZIndex, [newZIndex](int current, int total) {
+            std::cout << "\rz" << g_images.zHeights[newZIndex] << " - Loading: "
+                      << current << "/" << total << std::flush;
+            return true;
+        });
+        std::cout << std::endl;
+        if (!loaded) {
+            std::cerr << "Failed to load z" << g_images.zHeights[newZIndex] << std::endl;
+            return false;
+        }
     }
     
-    // Switch frames reference (no reloading needed!)
-    g_images.frames = g_images.zFrames[newZIndex];
-    g_images.allFilePaths = g_images.zAllFilePaths[newZIndex];
+    // Update z-index
+    g_images.currentZIndex = newZIndex;
+    
+    // activeFrames() now refers to the new slice; move the prefetch window
+    g_zLoader.setFocus(newZIndex);
+    
+    if (g_settings.debugMode) {
+        std::cout << "  Resident z-slices: " << g_zLoader.residentCount() << " ("
+                  << (g_zLoader.residentBytes() / (1024.0 * 1024.0)) << " MB)" << std::endl;
+    }
     
     // Restore frame position, clamped to new frame count
-    g_images.currentFrame = std::min(savedFramePosition, (int)g_images.frames.size() - 1);
+    g_images.currentFrame = std::min(savedFramePosition, (int)g_images.size() - 1);
     if (g_images.currentFrame < 0) g_images.currentFrame = 0;
     
     if (g_settings.debugMode && savedFramePosition != g_images.currentFrame) {
@@ -533,12 +566,52 @@ void UpdateWindowTitle() {
     // Add z-height info in 3D mode
     if (g_settings.mode3D && !g_images.zHeights.empty()) {
         zInfo = " [Z:" + std::to_string(g_images.zHeights[g_images.currentZIndex]) + "]";
+        
+        // Cross-section view and cut position
+        if (g_view.sliceView == SliceView::XZ) {
+            zInfo += " [XZ y=" + std::to_string((int)(g_view.cutY * g_images.imageHeight)) + "]";
+        } else if (g_view.sliceView == SliceView::YZ) {
+            zInfo += " [YZ x=" + std::to_string((int)(g_view.cutX * g_images.imageWidth)) + "]";
+        } else if (g_view.sliceView == SliceView::Projection) {
+            zInfo += std::string(" [") + ProjectionOpName(g_view.projectionOp) + " over z]";
+        }
+    }
+    
+    // Colormap and levels window of grayscale frames
+    if (g_images.pixelFormat != PixelFormat::RGB8) {
+        if (g_view.colormap != 0) {
+            zInfo += " [" + g_colormaps[g_view.colormap].name + "]";
+        }
+        if (g_view.levelLow != 0.0 || g_view.levelHigh != 1.0) {
+            double maxValue = MaxSampleValue(g_images.pixelFormat);
+            zInfo += " [levels " + std::to_string((int)std::lround(g_view.levelLow * maxValue)) + "-" +
+                     std::to_string((int)std::lround(g_view.levelHigh * maxValue)) + "]";
+        }
+    }
+    
+    // Watch mode
+    if (g_watcher.active()) {
+        zInfo += g_settings.watchFollow ? " [following]" : " [watching]";
+    } else if (g_watcher.ended()) {
+        zInfo += " [watch ended]";
+    }
+    
+    // Background export progress
+    ExportQueueStatus exportStatus = g_exportQueue.status();
+    if (exportStatus.running && exportStatus.framesTotal > 0) {
+        char exportInfo[64];
+        snprintf(exportInfo, sizeof(exportInfo), " | Export %.0f%%",
+                 100.0 * exportStatus.framesDone / exportStatus.framesTotal);
+        zInfo += exportInfo;
+        if (exportStatus.queued > 0) {
+            zInfo += " +" + std::to_string(exportStatus.queued) + " queued";
+        }
     }
     
     if (g_view.isPlaying) {
         const char* direction = (g_view.playDirection > 0) ? ">" : "<";
         snprintf(title, sizeof(title), "%s [%d/%zu]%s - %.1f FPS %s",
-                 g_images.frames[g_images.currentFrame].filename.c_str(),
+                 g_images.activeFrames()[g_images.currentFrame].filename.c_str(),
                  g_images.currentFrame + 1,
                  g_images.size(),
                  zInfo.c_str(),
@@ -546,7 +619,7 @@ void UpdateWindowTitle() {
                  direction);
     } else {
         snprintf(title, sizeof(title), "%s [%d/%zu]%s - Zoom: %.0f%%",
-                 g_images.frames[g_images.currentFrame].filename.c_str(),
+                 g_images.activeFrames()[g_images.currentFrame].filename.c_str(),
                  g_images.currentFrame + 1,
                  g_images.size(),
                  zInfo.c_str(),
@@ -555,6 +628,183 @@ void UpdateWindowTitle() {
     SDL_SetWindowTitle(g_window, title);
 }
 
+// Watch mode: add the files the watcher found since the last call to the sequence.
+// New frames are inserted in index order; the view stays on its frame unless following.
+void ApplyWatchedFiles() {
+    // The watch can end on its own (folder removed); show it instead of a live watch
+    static bool reportedEnd = false;
+    if (g_watcher.ended() && !reportedEnd) {
+        reportedEnd = true;
+        std::cout << "Watch ended: no more frames will be added" << std::endl;
+        UpdateWindowTitle();
+    }
+    
+    std::vector<std::string> names;
+    std::vector<ImageFrame> frames;
+    if (!g_watcher.takeNew(names, frames)) return;
+
+    for (const auto& name : names) {
+        g_images.allFiles.add(name.data(), name.size());
+    }
+    g_images.allFiles.sortByIndex();
+
+    for (auto& frame : frames) {
+        auto pos = std::upper_bound(g_images.frames.begin(), g_images.frames.end(), frame.index,
+            [](int64_t index, const ImageFrame& f) { return index < f.index; });
+        if (pos - g_images.frames.begin() <= g_images.currentFrame) {
+            g_images.currentFrame++;
+        }
+        g_images.frames.insert(pos, frame);
+    }
+    if (g_settings.watchFollow && !frames.empty()) {
+        g_images.currentFrame = (int)g_images.size() - 1;
+    }
+
+    if (g_settings.debugMode || !frames.empty()) {
+        std::cout << "Watch: " << names.size() << " new file(s), " << frames.size() << " decoded, "
+                  << g_images.size() << " frames loaded" << std::endl;
+    }
+    UpdateWindowTitle();
+}
+
+// Progress bar along the bottom edge while exports run in the background,
+// with one marker per queued job
+void DrawExportOverlay() {
+    ExportQueueStatus status = g_exportQueue.status();
+    if (!status.running || status.framesTotal <= 0) return;
+    
+    const int barHeight = 6;
+    int w = g_settings.windowWidth;
+    int h = g_settings.windowHeight;
+    double fraction = (double)status.framesDone / status.framesTotal;
+    
+    SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_BLEND);
+    
+    SDL_Rect background = {0, h - barHeight, w, barHeight};
+    SDL_SetRenderDrawColor(g_renderer, 0, 0, 0, 160);
+    SDL_RenderFillRect(g_renderer, &background);
+    
+    SDL_Rect done = {0, h - barHeight, (int)(w * fraction), barHeight};
+    SDL_SetRenderDrawColor(g_renderer, 80, 200, 120, 220);
+    SDL_RenderFillRect(g_renderer, &done);
+    
+    SDL_SetRenderDrawColor(g_renderer, 200, 200, 200, 200);
+    for (size_t i = 0; i < status.queued && i < 32; ++i) {
+        SDL_Rect marker = {w - (int)(i + 1) * (barHeight + 4), h - 2 * barHeight - 4, barHeight, barHeight};
+        SDL_RenderFillRect(g_renderer, &marker);
+    }
+    
+    SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_NONE);
+}
+
+// 3D mode: the current frame in every z-slice (nullptr where the slice is not resident yet)
+std::vector<const unsigned char*> CurrentFrameSlices() {
+    int numZ = (int)g_images.zFrames.size();
+    std::vector<const unsigned char*> slices(numZ, nullptr);
+    for (int z = 0; z < numZ; ++z) {
+        if (g_zLoader.isResident(z) && g_images.currentFrame < (int)g_images.zFrames[z].size()) {
+            slices[z] = g_images.zFrames[z][g_images.currentFrame].data;
+        }
+    }
+    return slices;
+}
+
+// Rebuild the colour table after the pixel format or the colormap changed
+const ColorLut& CurrentColorLut() {
+    if (g_colorLut.format() != g_images.pixelFormat || g_colorLutMap != g_view.colormap ||
+        g_colorLutLow != g_view.levelLow || g_colorLutHigh != g_view.levelHigh) {
+        g_colorLut.build(g_images.pixelFormat, &g_colormaps[g_view.colormap], g_view.levelLow, g_view.levelHigh);
+        g_colorLutMap = g_view.colormap;
+        g_colorLutLow = g_view.levelLow;
+        g_colorLutHigh = g_view.levelHigh;
+    }
+    return g_colorLut;
+}
+
+// Set the levels window of grayscale frames, in sample values
+void SetLevels(double low, double high) {
+    double maxValue = MaxSampleValue(g_images.pixelFormat);
+    high = std::max(high, low + 1.0);
+    g_view.levelLow = low / maxValue;
+    g_view.levelHigh = high / maxValue;
+    std::cout << "Levels: " << (int)std::lround(low) << " - " << (int)std::lround(high) << std::endl;
+    UpdateWindowTitle();
+}
+
+// Levels window from the 0.5% and 99.5% percentiles of the current frame or of the
+// whole sequence (current z-height in 3D mode), using the histograms taken at load time
+void AutoLevels(bool wholeSequence) {
+    if (g_images.pixelFormat == PixelFormat::RGB8 || g_images.isEmpty()) return;
+    Histogram histogram;
+    if (wholeSequence) {
+        histogram = SequenceHistogram(g_images.activeFrames());
+    } else if (g_images.activeFrames()[g_images.currentFrame].histogram) {
+        histogram = *g_images.activeFrames()[g_images.currentFrame].histogram;
+    }
+    if (histogram.samples == 0) {
+        std::cout << "Levels: no histogram for the " << (wholeSequence ? "sequence" : "current frame") << std::endl;
+        return;
+    }
+    std::cout << (wholeSequence ? "Sequence" : "Frame") << " samples " << histogram.minValue << " - "
+              << histogram.maxValue << ", ";
+    SetLevels(histogram.percentile(0.005), histogram.percentile(0.995));
+}
+
+// RGB for the texture upload: single-channel previews go through the colour table
+const unsigned char* DisplayRGB(const unsigned char* pixels, size_t count) {
+    CurrentColorLut();
+    return g_colorLut.toRGB(pixels, count, g_displayRGB);
+}
+
+// 3D mode: draw the XZ/YZ cross-section through the current frame, stretched to the
+// window, with the current z-height outlined
+void RenderCrossSection() {
+    int numZ = (int)g_images.zFrames.size();
+    if (numZ == 0) return;
+    
+    // Slices that are not resident (yet) stay black until they are loaded
+    std::vector<const unsigned char*> slices = CurrentFrameSlices();
+    
+    int position = (g_view.sliceView == SliceView::XZ)
+        ? (int)(g_view.cutY * g_images.imageHeight)
+        : (int)(g_view.cutX * g_images.imageWidth);
+    bool rebuilt = UpdateCrossSection(g_crossSection, g_view.sliceView, g_images.currentFrame, position,
+                                      slices, g_images.imageWidth, g_images.imageHeight,
+                                      g_images.pixelFormat, g_settings.numThreads);
+    
+    if (!g_sectionTexture || g_sectionTextureWidth != g_crossSection.width ||
+        g_sectionTextureHeight != g_crossSection.height) {
+        if (g_sectionTexture) SDL_DestroyTexture(g_sectionTexture);
+        g_sectionTexture = SDL_CreateTexture(g_renderer, SDL_PIXELFORMAT_RGB24, SDL_TEXTUREACCESS_STREAMING,
+                                             g_crossSection.width, g_crossSection.height);
+        if (!g_sectionTexture) {
+            std::cerr << "Failed to create cross-section texture: " << SDL_GetError() << std::endl;
+            return;
+        }
+        g_sectionTextureWidth = g_crossSection.width;
+        g_sectionTextureHeight = g_crossSection.height;
+        rebuilt = true;
+    }
+    if (rebuilt) {
+        const unsigned char* rgb = DisplayRGB(g_crossSection.pixels.data(),
+                                              (size_t)g_crossSection.width * g_crossSection.height);
+        SDL_UpdateTexture(g_sectionTexture, nullptr, rgb, g_crossSection.width * 3);
+    }
+    
+    SDL_Rect dstRect = {0, 0, g_settings.windowWidth, g_settings.windowHeight};
+    SDL_SetTextureScaleMode(g_sectionTexture, SDL_ScaleModeNearest);
+    SDL_RenderCopy(g_renderer, g_sectionTexture, nullptr, &dstRect);
+    
+    // Band of the current z-height (highest z at the top)
+    int bandTop = (numZ - 1 - g_images.currentZIndex) * g_settings.windowHeight / numZ;
+    int bandBottom = (numZ - g_images.currentZIndex) * g_settings.windowHeight / numZ;
+    SDL_Rect band = {0, bandTop, g_settings.windowWidth, std::max(1, bandBottom - bandTop)};
+    SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(g_renderer, 255, 220, 0, 180);
+    SDL_RenderDrawRect(g_renderer, &band);
+    SDL_SetRenderDrawBlendMode(g_renderer, SDL_BLENDMODE_NONE);
+}
+
 // Render current frame
 void RenderFrame() {
     // Clear to black
@@ -566,13 +816,28 @@ void RenderFrame() {
         return;
     }
     
-    // Update texture with current frame data
-    unsigned char* frameData = g_images.frames[g_images.currentFrame].data;
+    if (g_settings.mode3D && (g_view.sliceView == SliceView::XZ || g_view.sliceView == SliceView::YZ)) {
+        RenderCrossSection();
+        DrawExportOverlay();
+        SDL_RenderPresent(g_renderer);
+        return;
+    }
+    
+    // Update texture with current frame data, or its projection over z
+    const unsigned char* frameData = g_frameCache.pixels(g_images.activeFrames()[g_images.currentFrame],
+                                                         g_images.frameBytes());
+    if (g_settings.mode3D && g_view.sliceView == SliceView::Projection) {
+        const Projection* projection = g_projections.update(
+            g_view.projectionOp, g_images.currentFrame, CurrentFrameSlices(),
+            g_images.imageWidth, g_images.imageHeight, g_images.pixelFormat, g_settings.numThreads);
+        frameData = projection ? projection->pixels.data() : nullptr;
+    }
     if (!frameData) {
         SDL_RenderPresent(g_renderer);
         return;
     }
     
+    frameData = DisplayRGB(frameData, (size_t)g_images.imageWidth * g_images.imageHeight);
     SDL_UpdateTexture(g_texture, nullptr, frameData, g_images.imageWidth * 3);
     
     // Calculate render parameters
@@ -587,6 +852,8 @@ void RenderFrame() {
     SDL_SetTextureScaleMode(g_texture, SDL_ScaleModeLinear);
     SDL_RenderCopy(g_renderer, g_texture, &srcRect, &dstRect);
     
+    DrawExportOverlay();
+    
     SDL_RenderPresent(g_renderer);
 }
 
@@ -609,8 +876,92 @@ void ParseArguments(int argc, char* argv[]) {
             g_settings.windowHeight = std::clamp(atoi(argv[i + 1]), 100, 4320);
             i++;
         }
+        else if (strcmp(argv[i], "--export-size") == 0 && i + 1 < argc) {
+            int w = 0, h = 0;
+            if (sscanf(argv[i + 1], "%dx%d", &w, &h) == 2) {
+                g_settings.exportWidth = std::clamp(w, 16, 16384);
+                g_settings.exportHeight = std::clamp(h, 16, 16384);
+            } else {
+                std::cerr << "Invalid --export-size '" << argv[i + 1] << "', expected <width>x<height>" << std::endl;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--export-fps") == 0 && i + 1 < argc) {
+            g_settings.exportFPS = std::clamp(atoi(argv[i + 1]), 1, 240);
+            i++;
+        }
+        else if (strcmp(argv[i], "--export-aspect") == 0 && i + 1 < argc) {
+            if (strcmp(argv[i + 1], "fit") == 0) {
+                g_settings.exportAspect = ExportAspect::Fit;
+            } else if (strcmp(argv[i + 1], "fill") == 0) {
+                g_settings.exportAspect = ExportAspect::Fill;
+            } else if (strcmp(argv[i + 1], "stretch") == 0) {
+                g_settings.exportAspect = ExportAspect::Stretch;
+            } else {
+                std::cerr << "Invalid --export-aspect '" << argv[i + 1] << "', expected fit, fill or stretch" << std::endl;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--export-segments") == 0 && i + 1 < argc) {
+            g_settings.exportSegments = std::clamp(atoi(argv[i + 1]), 1, kMaxExportSegments);
+            i++;
+        }
+        else if (strcmp(argv[i], "--export-format") == 0 && i + 1 < argc) {
+            const char* name = argv[i + 1];
+            if (strcmp(name, "h264") == 0 || strcmp(name, "mp4") == 0) {
+                g_settings.exportFormat = ExportFormat::H264;
+            } else if (strcmp(name, "ffv1") == 0) {
+                g_settings.exportFormat = ExportFormat::FFV1;
+            } else if (strcmp(name, "raw") == 0) {
+                g_settings.exportFormat = ExportFormat::Raw;
+            } else if (strcmp(name, "y4m") == 0) {
+                g_settings.exportFormat = ExportFormat::Y4M;
+            } else if (strcmp(name, "png") == 0) {
+                g_settings.exportFormat = ExportFormat::PNG;
+            } else {
+                std::cerr << "Invalid --export-format '" << name << "', expected h264, ffv1, raw, y4m or png" << std::endl;
+            }
+            i++;
+        }
+        else if ((strcmp(argv[i], "-o") == 0 || strcmp(argv[i], "--export-output") == 0) && i + 1 < argc) {
+            g_settings.exportOutput = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], "--export-checkpoint") == 0 && i + 1 < argc) {
+            g_settings.exportCheckpoint = std::max(0, atoi(argv[i + 1]));
+            i++;
+        }
+        else if (strcmp(argv[i], "--export-resume") == 0) {
+            g_settings.exportResume = true;
+        }
+        else if (strcmp(argv[i], "--batch-export") == 0) {
+            g_settings.batchExport = true;
+        }
+        else if (strcmp(argv[i], "--export-share") == 0 && i + 1 < argc) {
+            g_settings.exportCPUShare = std::clamp(atof(argv[i + 1]), 0.05, 1.0);
+            i++;
+        }
+        else if (strcmp(argv[i], "--z-cache") == 0 && i + 1 < argc) {
+            g_settings.zCacheMB = std::max(0, atoi(argv[i + 1]));
+            i++;
+        }
         else if ((strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--threads") == 0) && i + 1 < argc) {
-            g_settings.numThreads = std::clamp(atoi(argv[i + 1]), 1, 128);
+            g_settings.numThreads = std::clamp(atoi(argv[i + 1]), 0, 4096);
+            i++;
+        }
+        else if (strcmp(argv[i], "--export-threads") == 0 && i + 1 < argc) {
+            g_settings.exportThreads = std::clamp(atoi(argv[i + 1]), 0, 4096);
+            i++;
+        }
+        else if (strcmp(argv[i], "--encode-threads") == 0 && i + 1 < argc) {
+            g_settings.encodeThreads = std::clamp(atoi(argv[i + 1]), 0, 4096);
+            i++;
+        }
+        else if (strcmp(argv[i], "--pin-threads") == 0) {
+            g_settings.pinThreads = true;
+        }
+        else if (strcmp(argv[i], "--io-threads") == 0 && i + 1 < argc) {
+            g_settings.ioThreads = std::clamp(atoi(argv[i + 1]), 0, 256);
             i++;
         }
         else if ((strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--folder") == 0) && i + 1 < argc) {
@@ -620,6 +971,66 @@ void ParseArguments(int argc, char* argv[]) {
         else if (strcmp(argv[i], "--3d") == 0 || strcmp(argv[i], "--3D") == 0) {
             g_settings.mode3D = true;
         }
+        else if (strcmp(argv[i], "--watch") == 0) {
+            g_settings.watchFolder = true;
+        }
+        else if (strcmp(argv[i], "--follow") == 0) {
+            g_settings.watchFolder = true;
+            g_settings.watchFollow = true;
+        }
+        else if (strcmp(argv[i], "--rgb") == 0) {
+            g_settings.forceRGB = true;
+        }
+        else if (strcmp(argv[i], "--compress") == 0 && i + 1 < argc) {
+            std::string mode = argv[i + 1];
+            if (mode == "rle") {
+                g_settings.frameCompression = FrameCompression::RLE;
+            } else if (mode == "lz4") {
+                g_settings.frameCompression = FrameCompression::LZ4;
+                if (!FrameCompressionAvailable(FrameCompression::LZ4)) {
+                    std::cerr << "Built without LZ4 (make LZ4=1), using --compress rle" << std::endl;
+                    g_settings.frameCompression = FrameCompression::RLE;
+                }
+            } else {
+                g_settings.frameCompression = FrameCompression::Off;
+            }
+            g_settings.frameCompressionSet = true;
+            i++;
+        }
+        else if (strcmp(argv[i], "--huge-pages") == 0 && i + 1 < argc) {
+            std::string mode = argv[i + 1];
+            g_settings.hugePages = (mode == "thp") ? HugePageMode::Transparent
+                                 : (mode == "hugetlb") ? HugePageMode::HugeTLB : HugePageMode::Off;
+            i++;
+        }
+        else if (strcmp(argv[i], "--numa") == 0 && i + 1 < argc) {
+            std::string mode = argv[i + 1];
+            g_settings.numaPlacement = (mode == "interleave") ? NumaPlacement::Interleave
+                                     : (mode == "display") ? NumaPlacement::Display : NumaPlacement::Off;
+            i++;
+        }
+        else if (strcmp(argv[i], "--mem-budget") == 0 && i + 1 < argc) {
+            g_settings.memBudgetMB = std::max(0, atoi(argv[i + 1]));
+            i++;
+        }
+        else if (strcmp(argv[i], "--keyframe") == 0 && i + 1 < argc) {
+            g_settings.keyframeInterval = std::clamp(atoi(argv[i + 1]), 1, 1000);
+            i++;
+        }
+        else if (strcmp(argv[i], "--colormap") == 0 && i + 1 < argc) {
+            g_settings.colormap = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc) {
+            if (strcmp(argv[i + 1], "auto") == 0) {
+                g_settings.autoLevels = true;
+            } else if (sscanf(argv[i + 1], "%lf,%lf", &g_settings.levelsLow, &g_settings.levelsHigh) != 2 ||
+                       g_settings.levelsLow < 0.0 || g_settings.levelsHigh <= g_settings.levelsLow) {
+                std::cerr << "Invalid --levels " << argv[i + 1] << " (expected <low>,<high> or auto)" << std::endl;
+                g_settings.levelsLow = g_settings.levelsHigh = -1.0;
+            }
+            i++;
+        }
         else if (strcmp(argv[i], "--debug") == 0) {
             g_settings.debugMode = true;
         }
@@ -628,12 +1039,37 @@ void ParseArguments(int argc, char* argv[]) {
             std::cout << "Options:" << std::endl;
             std::cout << "  -f, --folder <path>    Folder containing images (required)" << std::endl;
             std::cout << "  --3d, --3D             3D mode: folder contains z<number> subfolders" << std::endl;
+            std::cout << "  --watch                Add frames written to the folder while viewing (2D mode)" << std::endl;
+            std::cout << "  --follow               Like --watch, and jump to each new frame as it arrives" << std::endl;
+            std::cout << "  --rgb                  Store grayscale previews as RGB (default: native 8/16-bit gray)" << std::endl;
+            std::cout << "  --compress <mode>      2D mode: keep previews compressed: off, rle or lz4 (default: off)" << std::endl;
+            std::cout << "  --keyframe <n>         With --compress: a keyframe every n frames, the others stored as deltas (default: 8)" << std::endl;
+            std::cout << "  --mem-budget <MB>      Choose shrink, stride and compression so previews fit in MB of RAM" << std::endl;
+            std::cout << "  --huge-pages <mode>    Back preview buffers with huge pages: off, thp or hugetlb (default: off)" << std::endl;
+            std::cout << "  --numa <mode>          NUMA placement of preview buffers: off, interleave or display (default: off)" << std::endl;
+            std::cout << "  --colormap <name|file> Grayscale colormap: gray, viridis, inferno, diverging or a LUT file (default: gray)" << std::endl;
+            std::cout << "  --levels <low>,<high>  Grayscale levels window in sample values, or 'auto' (default: full range)" << std::endl;
             std::cout << "  --debug                Show debug output" << std::endl;
+            std::cout << "  --z-cache <MB>         3D mode: memory for prefetched z-slices (default: half of RAM)" << std::endl;
             std::cout << "  -s, --shrink <factor>  Shrink factor for images (default: auto)" << std::endl;
             std::cout << "  -n, --nth <n>          Load every n-th image (default: 1)" << std::endl;
             std::cout << "  -x <width>             Window width in pixels (default: 1000)" << std::endl;
             std::cout << "  -y <height>            Window height in pixels (default: 1000)" << std::endl;
-            std::cout << "  -t, --threads <n>      Number of threads (default: 72)" << std::endl;
+            std::cout << "  -t, --threads <n>      Worker threads shared by loading, exports and 3D views (default: CPUs in the affinity mask and cgroup quota)" << std::endl;
+            std::cout << "  --io-threads <n>       Threads reading files ahead of the decoders, 0 = decoders read (default: 8)" << std::endl;
+            std::cout << "  --export-size <WxH>    Export resolution (default: window size)" << std::endl;
+            std::cout << "  --export-fps <n>       Export frame rate (default: 30)" << std::endl;
+            std::cout << "  --export-aspect <mode> fit, fill or stretch when export and window aspect differ (default: fit)" << std::endl;
+            std::cout << "  --export-segments <k>  Encode k segments in parallel (1-256), then concatenate (default: 1)" << std::endl;
+            std::cout << "  --export-format <fmt>  h264, ffv1 (lossless), raw (RGB24), y4m or png sequence (default: h264)" << std::endl;
+            std::cout << "  -o, --export-output <path>  Export file (directory for png, - for stdout with raw/y4m)" << std::endl;
+            std::cout << "  --export-checkpoint <n> Write n-frame segments recorded in <output>.manifest (not stdout)" << std::endl;
+            std::cout << "  --export-resume        Continue an interrupted export (skips finished segments / PNG frames)" << std::endl;
+            std::cout << "  --batch-export         Export the starting view without opening a window, then exit" << std::endl;
+            std::cout << "  --export-share <f>     Fraction of the threads used by background exports (default: 0.5)" << std::endl;
+            std::cout << "  --export-threads <n>   Export render threads (at most --threads), overrides --export-share (default: 0 = share)" << std::endl;
+            std::cout << "  --encode-threads <n>   ffmpeg threads of an export (default: 0 = export render threads)" << std::endl;
+            std::cout << "  --pin-threads          Pin the shared worker threads to CPUs, distinct cores first" << std::endl;
             std::cout << "  -h, --help             Show this help message" << std::endl;
             std::cout << "\nControls:" << std::endl;
             std::cout << "  Left/Right Arrow, A/D: Navigate frames" << std::endl;
@@ -644,8 +1080,13 @@ void ParseArguments(int argc, char* argv[]) {
             std::cout << "  Mouse Wheel:           Zoom in/out" << std::endl;
             std::cout << "  Shift + Mouse Wheel:   Change z-height (3D mode only)" << std::endl;
             std::cout << "  Left Drag:             Pan" << std::endl;
+            std::cout << "  V:                     Cycle XY / XZ / YZ cross-section view (3D mode only)" << std::endl;
+            std::cout << "  [ / ] (Shift: x10):    Move the cross-section cut (3D mode only)" << std::endl;
+            std::cout << "  P:                     Max / min / mean projection over z (3D mode only)" << std::endl;
+            std::cout << "  F:                     Follow the newest frame on/off (watch mode)" << std::endl;
             std::cout << "  R:                     Reset view" << std::endl;
-            std::cout << "  S:                     Export to MP4" << std::endl;
+            std::cout << "  S:                     Queue a background export of the current view (see --export-format)" << std::endl;
+            std::cout << "  C / Shift+C:           Cancel the running export / cancel all queued exports" << std::endl;
             std::cout << "  Q/Escape:              Quit" << std::endl;
             exit(0);
         }
@@ -659,6 +1100,15 @@ int main(int argc, char* argv[]) {
     
     // Parse command line
     ParseArguments(argc, argv);
+
+    // Streaming an export to stdout: keep all console output on stderr
+    if (g_settings.exportOutput == "-") {
+        if (g_settings.exportFormat != ExportFormat::Raw && g_settings.exportFormat != ExportFormat::Y4M) {
+            std::cerr << "Export to stdout requires --export-format raw or y4m" << std::endl;
+            return -1;
+        }
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
     
     std::cout << "PNG Image Viewer (Linux/SDL2)" << std::endl;
     std::cout << "=============================" << std::endl;
@@ -666,7 +1116,45 @@ int main(int argc, char* argv[]) {
     std::cout << "Window: " << g_settings.windowWidth << " x " << g_settings.windowHeight << std::endl;
     std::cout << "Shrink factor: " << (g_settings.shrinkFactor == 0 ? "auto" : std::to_string(g_settings.shrinkFactor)) << std::endl;
     std::cout << "Load every " << g_settings.nthFrame << "-th image" << std::endl;
-    std::cout << "Threads: " << g_settings.numThreads << std::endl;
+    // Threads default to the CPUs this job may use, not the machine's core count
+    CpuBudget cpus = DetectCpuBudget();
+    bool autoThreads = g_settings.numThreads == 0;
+    if (autoThreads) {
+        g_settings.numThreads = cpus.available;
+    }
+    std::cout << "Threads: " << g_settings.numThreads << " (" << g_settings.ioThreads << " read-ahead)";
+    if (autoThreads) {
+        std::cout << ", from " << cpus.affinityCPUs << " CPUs in the affinity mask";
+        if (cpus.quotaCPUs > 0) {
+            std::cout << " and a cgroup quota of " << cpus.quotaCPUs << " CPUs";
+        }
+    }
+    std::cout << std::endl;
+    std::cout << "Thread pinning: " << ConfigureThreadPinning(g_settings.pinThreads) << std::endl;
+    
+    // One pool of workers for loading, z-slice prefetch, exports and the 3D views
+    SharedThreadPool().start(g_settings.numThreads);
+    // Before loading, on this (the display) thread, so "display" placement finds its node
+    std::cout << "Frame memory: " << ConfigureFrameMemory(g_settings.hugePages, g_settings.numaPlacement) << std::endl;
+    if (g_settings.exportWidth > 0) {
+        std::cout << "Export: " << g_settings.exportWidth << " x " << g_settings.exportHeight
+                  << " @ " << g_settings.exportFPS << " fps (" << ExportAspectName(g_settings.exportAspect) << ")" << std::endl;
+    }
+    
+    // Colormaps for grayscale frames; a name that is not built in is a LUT file
+    g_colormaps = BuiltinColormaps();
+    auto colormap = std::find_if(g_colormaps.begin(), g_colormaps.end(),
+                                 [](const Colormap& map) { return map.name == g_settings.colormap; });
+    if (colormap != g_colormaps.end()) {
+        g_view.colormap = (int)(colormap - g_colormaps.begin());
+    } else {
+        Colormap custom;
+        if (!LoadColormapFile(g_settings.colormap, custom)) {
+            return -1;
+        }
+        g_colormaps.push_back(custom);
+        g_view.colormap = (int)g_colormaps.size() - 1;
+    }
     
     // Check for folder argument
     if (g_settings.initialFolder.empty()) {
@@ -676,6 +1164,10 @@ int main(int argc, char* argv[]) {
         return -1;
     }
     
+    if (g_settings.batchExport) {
+        return RunBatchExport();
+    }
+    
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         std::cerr << "SDL initialization failed: " << SDL_GetError() << std::endl;
@@ -721,6 +1213,13 @@ int main(int argc, char* argv[]) {
         return -1;
     }
     
+    // Initial levels window of grayscale frames
+    if (g_settings.autoLevels) {
+        AutoLevels(true);
+    } else if (g_settings.levelsLow >= 0.0 && g_images.pixelFormat != PixelFormat::RGB8) {
+        SetLevels(g_settings.levelsLow, g_settings.levelsHigh);
+    }
+    
     // Create texture
     if (!CreateTexture()) {
         g_images.cleanup();
@@ -736,23 +1235,37 @@ int main(int argc, char* argv[]) {
     using Clock = std::chrono::high_resolution_clock;
     auto lastFrameTime = Clock::now();
     
+    InstallExportCallbacks();
+    
     // Main loop
     bool running = true;
+    bool quitWarned = false;    // Quitting with exports running needs a second request
+    bool wasExporting = false;
     SDL_Event event;
     
+    // Quitting cancels background exports, so ask for confirmation first
+    auto requestQuit = [&]() {
+        if (g_exportQueue.busy() && !quitWarned) {
+            quitWarned = true;
+            std::cout << "\nExport still running: quit again to cancel it and exit" << std::endl;
+            return;
+        }
+        running = false;
+    };
+    
     while (running && !g_interrupted.load()) {
         // Process events
         while (SDL_PollEvent(&event)) {
             switch (event.type) {
                 case SDL_QUIT:
-                    running = false;
+                    requestQuit();
                     break;
                 
                 case SDL_KEYDOWN:
                     switch (event.key.keysym.sym) {
                         case SDLK_q:
                         case SDLK_ESCAPE:
-                            running = false;
+                            requestQuit();
                             break;
                         
                         case SDLK_LEFT:
@@ -827,14 +1340,100 @@ int main(int argc, char* argv[]) {
                             UpdateWindowTitle();
                             break;
                         
+                        case SDLK_v:
+                            // 3D mode: cycle XY -> XZ -> YZ cross-sections
+                            if (g_settings.mode3D) {
+                                g_view.sliceView = (g_view.sliceView == SliceView::XY) ? SliceView::XZ
+                                                 : (g_view.sliceView == SliceView::XZ) ? SliceView::YZ
+                                                 : SliceView::XY;  // Also leaves the projection view
+                                std::cout << "View: " << SliceViewName(g_view.sliceView) << std::endl;
+                                UpdateWindowTitle();
+                            }
+                            break;
+                        
+                        case SDLK_p:
+                            // 3D mode: projection over z, cycling max -> min -> mean -> XY view
+                            if (g_settings.mode3D) {
+                                if (g_view.sliceView != SliceView::Projection) {
+                                    g_view.sliceView = SliceView::Projection;
+                                    g_view.projectionOp = ProjectionOp::Max;
+                                } else if (g_view.projectionOp == ProjectionOp::Max) {
+                                    g_view.projectionOp = ProjectionOp::Min;
+                                } else if (g_view.projectionOp == ProjectionOp::Min) {
+                                    g_view.projectionOp = ProjectionOp::Mean;
+                                } else {
+                                    g_view.sliceView = SliceView::XY;
+                                }
+                                std::cout << "View: " << SliceViewName(g_view.sliceView);
+                                if (g_view.sliceView == SliceView::Projection) {
+                                    std::cout << " (" << ProjectionOpName(g_view.projectionOp) << ")";
+                                }
+                                std::cout << std::endl;
+                                UpdateWindowTitle();
+                            }
+                            break;
+                        
+                        case SDLK_m: {
+                            // Next colormap for grayscale frames (Shift: previous)
+                            if (g_images.pixelFormat == PixelFormat::RGB8) break;
+                            int count = (int)g_colormaps.size();
+                            int step = (SDL_GetModState() & KMOD_SHIFT) ? count - 1 : 1;
+                            g_view.colormap = (g_view.colormap + step) % count;
+                            std::cout << "Colormap: " << g_colormaps[g_view.colormap].name << std::endl;
+                            UpdateWindowTitle();
+                            break;
+                        }
+                        
+                        case SDLK_l:
+                            // Levels from the current frame's histogram (Shift: whole sequence)
+                            AutoLevels((SDL_GetModState() & KMOD_SHIFT) != 0);
+                            break;
+                        
+                        case SDLK_k:
+                            // Full sample range
+                            if (g_images.pixelFormat == PixelFormat::RGB8) break;
+                            SetLevels(0.0, MaxSampleValue(g_images.pixelFormat));
+                            break;
+                        
+                        case SDLK_LEFTBRACKET:
+                        case SDLK_RIGHTBRACKET: {
+                            // Move the cross-section cut by 1% of the image (Shift: 10%)
+                            if (!g_settings.mode3D || g_view.sliceView == SliceView::XY) break;
+                            double step = (SDL_GetModState() & KMOD_SHIFT) ? 0.1 : 0.01;
+                            if (event.key.keysym.sym == SDLK_LEFTBRACKET) step = -step;
+                            double& cut = (g_view.sliceView == SliceView::XZ) ? g_view.cutY : g_view.cutX;
+                            cut = std::clamp(cut + step, 0.0, 1.0);
+                            UpdateWindowTitle();
+                            break;
+                        }
+                        
+                        case SDLK_f:
+                            // Watch mode: toggle jumping to each new frame
+                            if (g_watcher.active()) {
+                                g_settings.watchFollow = !g_settings.watchFollow;
+                                if (g_settings.watchFollow) {
+                                    g_images.currentFrame = (int)g_images.size() - 1;
+                                }
+                                std::cout << "Follow newest frame: " << (g_settings.watchFollow ? "on" : "off") << std::endl;
+                                UpdateWindowTitle();
+                            }
+                            break;
+                        
                         case SDLK_r:
                             g_view.reset();
                             UpdateWindowTitle();
                             break;
                         case SDLK_s:
-                            g_view.isPlaying = false;
-                            std::cout << "\n[S] pressed: starting MULTI-THREADED MP4 export..." << std::endl;
-                            ExportToMP4_MT();
+                            QueueExport();
+                            break;
+                        
+                        case SDLK_c:
+                            // C cancels the running export, Shift+C also clears the queue
+                            if (SDL_GetModState() & KMOD_SHIFT) {
+                                g_exportQueue.cancelAll();
+                            } else {
+                                g_exportQueue.cancelCurrent();
+                            }
                             break;
                     }
                     break;
@@ -883,12 +1482,18 @@ int main(int argc, char* argv[]) {
                         g_view.isDragging = true;
                         g_view.lastMouseX = event.button.x;
                         g_view.lastMouseY = event.button.y;
+                    } else if (event.button.button == SDL_BUTTON_RIGHT && g_images.pixelFormat != PixelFormat::RGB8) {
+                        g_view.isLeveling = true;
+                        g_view.lastMouseX = event.button.x;
+                        g_view.lastMouseY = event.button.y;
                     }
                     break;
                 
                 case SDL_MOUSEBUTTONUP:
                     if (event.button.button == SDL_BUTTON_LEFT) {
                         g_view.isDragging = false;
+                    } else if (event.button.button == SDL_BUTTON_RIGHT) {
+                        g_view.isLeveling = false;
                     }
                     break;
                 
@@ -896,6 +1501,20 @@ int main(int argc, char* argv[]) {
                     if (g_view.isDragging) {
                         ApplyPan(g_view, g_settings, g_images.imageWidth, g_images.imageHeight,
                                  event.motion.x, event.motion.y);
+                    } else if (g_view.isLeveling) {
+                        // Levels: right/left moves the window up/down the sample range,
+                        // up/down narrows/widens it (a window height doubles or halves it)
+                        double width = g_view.levelHigh - g_view.levelLow;
+                        double center = (g_view.levelHigh + g_view.levelLow) / 2.0
+                                      + width * (event.motion.x - g_view.lastMouseX) / g_settings.windowWidth;
+                        width *= std::pow(2.0, (double)(event.motion.y - g_view.lastMouseY) / g_settings.windowHeight);
+                        width = std::clamp(width, 1.0 / MaxSampleValue(g_images.pixelFormat), 2.0);
+                        center = std::clamp(center, 0.0, 1.0);
+                        g_view.levelLow = center - width / 2.0;
+                        g_view.levelHigh = center + width / 2.0;
+                        g_view.lastMouseX = event.motion.x;
+                        g_view.lastMouseY = event.motion.y;
+                        UpdateWindowTitle();
                     }
                     break;
             }
@@ -931,18 +1550,42 @@ int main(int argc, char* argv[]) {
             UpdateWindowTitle();
         }
         
+        // Watch mode: frames that appeared in the folder
+        ApplyWatchedFiles();
+        
+        // Keep the export progress in the title current; once more after the last job ends
+        bool exporting = g_exportQueue.busy();
+        if (exporting || wasExporting) {
+            UpdateWindowTitle();
+        }
+        if (!exporting) {
+            quitWarned = false;
+        }
+        wasExporting = exporting;
+        
         // Render
         RenderFrame();
         
-        // If not playing, wait for events to save CPU
+        // If not playing, wait for events to save CPU (wake up for export progress and new frames)
         if (!g_view.isPlaying) {
-            SDL_WaitEvent(nullptr);
+            if (exporting || g_watcher.active()) {
+                SDL_WaitEventTimeout(nullptr, 100);
+            } else {
+                SDL_WaitEvent(nullptr);
+            }
         }
     }
     
     // Cleanup
+    if (g_exportQueue.busy()) {
+        std::cout << "\nCancelling background export..." << std::endl;
+    }
+    g_exportQueue.shutdown();
+    g_watcher.stop();
+    g_zLoader.stop();
     g_images.cleanup();
     if (g_texture) SDL_DestroyTexture(g_texture);
+    if (g_sectionTexture) SDL_DestroyTexture(g_sectionTexture);
     SDL_DestroyRenderer(g_renderer);
     SDL_DestroyWindow(g_window);
     SDL_Quit();
@@ -950,180 +1593,186 @@ int main(int argc, char* argv[]) {
     return 0;
 }
 
-// Multi-threaded MP4 export using ffmpeg
-void ExportToMP4_MT() {
-    if (g_images.allFilePaths.empty()) {
+// Queue an export of the current view; it runs in the background
+void QueueExport() {
+    if (g_images.activeFiles().empty()) {
         std::cerr << "No images loaded to export!" << std::endl;
         return;
     }
 
-    bool wasPlaying = g_view.isPlaying;
-    g_view.isPlaying = false;
-
-    int fps = 30;
-    int winW = g_settings.windowWidth;
-    int winH = g_settings.windowHeight;
-    size_t totalFrames = g_images.allFilePaths.size();
-    int numExportThreads = g_settings.numThreads;
-    if (numExportThreads < 1) numExportThreads = 1;
+    // Background exports get a share of the threads so the viewer stays responsive;
+    // they render on the shared pool, so --threads is the cap
+    int exportThreads = g_settings.exportThreads > 0
+        ? g_settings.exportThreads
+        : std::max(1, (int)std::lround(g_settings.numThreads * g_settings.exportCPUShare));
+    exportThreads = std::clamp(exportThreads, 1, std::max(1, SharedThreadPool().size()));
 
-    size_t frameBufferSize = static_cast<size_t>(winW) * winH * 3;
+    // Export size and frame rate are independent of the preview window
+    ExportJob job;
+    job.files = g_images.activeFiles();
+    job.view = g_view;
+    job.pixelFormat = g_images.pixelFormat;
+    job.colorLut = CurrentColorLut();
+    job.settings = g_settings;
+    job.displayedWidth = g_images.imageWidth;
+    job.displayedHeight = g_images.imageHeight;
+    job.fps = g_settings.exportFPS;
+    job.outWidth = g_settings.exportWidth > 0 ? g_settings.exportWidth : g_settings.windowWidth;
+    job.outHeight = g_settings.exportHeight > 0 ? g_settings.exportHeight : g_settings.windowHeight;
+    job.numThreads = exportThreads;
+    job.ioThreads = g_settings.ioThreads;
+    job.encoderThreads = g_settings.encodeThreads > 0 ? g_settings.encodeThreads : exportThreads;
+    job.numSegments = g_settings.exportSegments;
+    job.format = g_settings.exportFormat;
+    job.checkpointFrames = g_settings.exportCheckpoint;
+    job.resume = g_settings.exportResume;
 
-    // Place the output MP4 in the same directory as the -f folder
+    // Place the output in the same directory as the -f folder unless given explicitly
     std::string folder = g_settings.initialFolder;
     // Remove trailing slash if present
     while (!folder.empty() && folder.back() == '/') {
         folder.pop_back();
     }
     
-    // In 3D mode, add z-height to filename
-    std::string filename;
-    if (g_settings.mode3D && !g_images.zHeights.empty()) {
-        filename = folder + "/export_output_z" + 
-                   std::to_string(g_images.zHeights[g_images.currentZIndex]) + "_mt.mp4";
+    std::string extension = ExportFormatExtension(job.format);
+    std::string baseName;
+    if (g_settings.exportOutput == "-") {
+        // A second stream would be appended to the first on stdout
+        if (g_exportQueue.hasOutput("-")) {
+            std::cout << "\n[S] pressed: an export to stdout is already queued or running" << std::endl;
+            return;
+        }
+        job.outputFile = "-";
+    } else if (!g_settings.exportOutput.empty()) {
+        // Split off the extension (if any) of -o so repeated jobs are numbered before it
+        job.outputFile = g_settings.exportOutput;
+        size_t slash = job.outputFile.find_last_of('/');
+        size_t dot = job.outputFile.find_last_of('.');
+        if (dot != std::string::npos && (slash == std::string::npos || dot > slash + 1)) {
+            baseName = job.outputFile.substr(0, dot);
+            extension = job.outputFile.substr(dot);
+        } else {
+            baseName = job.outputFile;
+            extension.clear();
+        }
+    } else if (g_settings.mode3D && !g_images.zHeights.empty()) {
+        // In 3D mode, add z-height to filename
+        baseName = folder + "/export_output_z" + 
+                   std::to_string(g_images.zHeights[g_images.currentZIndex]) + "_mt";
+        job.outputFile = baseName + extension;
     } else {
-        filename = folder + "/export_output_mt.mp4";
+        baseName = folder + "/export_output_mt";
+        job.outputFile = baseName + extension;
+    }
+
+    // Jobs queued from the same view would otherwise overwrite each other
+    for (int n = 2; !baseName.empty() && g_exportQueue.hasOutput(job.outputFile); ++n) {
+        job.outputFile = baseName + "_" + std::to_string(n) + extension;
     }
     
-    std::cout << "\n[S] pressed: starting MULTI-THREADED MP4 export..." << std::endl;
-    std::cout << "Output file : " << filename << std::endl;
-    std::cout << "Resolution  : " << winW << " x " << winH << std::endl;
-    std::cout << "FPS         : " << fps << std::endl;
-    std::cout << "Total frames: " << totalFrames << std::endl;
-    std::cout << "Threads     : " << numExportThreads << std::endl;
+    ExportQueueStatus queueStatus = g_exportQueue.status();
+    size_t jobsAhead = queueStatus.queued + (queueStatus.running ? 1 : 0);
+
+    std::cout << (g_settings.batchExport ? "\nQueueing batch export..." : "\n[S] pressed: queueing MULTI-THREADED export...")
+              << std::endl;
+    std::cout << "Output file : " << (job.outputFile == "-" ? "<stdout>" : job.outputFile) << std::endl;
+    std::cout << "Format      : " << ExportFormatName(job.format) << std::endl;
+    std::cout << "Resolution  : " << job.outWidth << " x " << job.outHeight << std::endl;
+    std::cout << "Aspect      : " << ExportAspectName(g_settings.exportAspect) << std::endl;
+    std::cout << "FPS         : " << job.fps << std::endl;
+    std::cout << "Total frames: " << job.files.size() << std::endl;
+    if (g_settings.exportThreads > 0) {
+        std::cout << "Threads     : " << job.numThreads << " render";
+        if (job.numThreads < g_settings.exportThreads) {
+            std::cout << " (--export-threads " << g_settings.exportThreads << " capped by --threads)";
+        }
+        std::cout << ", " << job.encoderThreads << " encode" << std::endl;
+    } else {
+        std::cout << "Threads     : " << job.numThreads << " (" << (int)std::lround(g_settings.exportCPUShare * 100)
+                  << "% of " << g_settings.numThreads << "), " << job.encoderThreads << " encode" << std::endl;
+    }
+    if (job.numSegments > 1) {
+        std::cout << "Segments    : " << job.numSegments << " parallel encoders" << std::endl;
+    }
+    if (job.checkpointFrames > 0) {
+        std::cout << "Checkpoint  : every " << job.checkpointFrames << " frames" << std::endl;
+    }
     if (g_settings.mode3D && !g_images.zHeights.empty()) {
         std::cout << "Z-height    : " << g_images.zHeights[g_images.currentZIndex] << std::endl;
     }
-
-    char cmd[1024];
-    std::snprintf(cmd, sizeof(cmd),
-        "ffmpeg -y -f rawvideo -pixel_format rgb24 -video_size %dx%d -framerate %d -i - "
-        "-c:v libx264 -pix_fmt yuv444p -crf 18 \"%s\"",
-        winW, winH, fps, filename.c_str());
-
-    FILE* ffmpeg = popen(cmd, "w");
-    if (!ffmpeg) {
-        std::cerr << "Failed to start ffmpeg. Is it installed and in PATH?" << std::endl;
-        g_view.isPlaying = wasPlaying;
-        return;
+    if (jobsAhead > 0) {
+        std::cout << "Queued behind " << jobsAhead << " export(s)" << std::endl;
     }
 
-    std::mutex queueMutex;
-    std::condition_variable queueNotFull;
-    std::condition_variable queueNotEmpty;
-    std::map<size_t, unsigned char*> renderedFrames;
-    std::atomic<size_t> nextFrameToRender(0);
-    size_t nextFrameToWrite = 0;
-
-    size_t maxQueueSize = static_cast<size_t>(numExportThreads) * 2;
-
-    ViewState capturedView = g_view;
-    AppSettings capturedSettings = g_settings;
-    int displayedW = g_images.imageWidth;
-    int displayedH = g_images.imageHeight;
+    g_exportQueue.enqueue(job);
+    UpdateWindowTitle();
+}
 
-    auto renderWorker = [&]() {
-        while (true) {
-            size_t idx = nextFrameToRender.fetch_add(1);
-            if (idx >= totalFrames) break;
-            if (g_interrupted.load()) break;
+// Exports that failed or were interrupted, for the exit status of --batch-export
+std::atomic<int> g_exportFailures(0);
 
-            unsigned char* buffer = new unsigned char[frameBufferSize];
-            std::memset(buffer, 0, frameBufferSize);
+// Console reporting for background exports (called on the export thread)
+void InstallExportCallbacks() {
+    g_exportQueue.setCallbacks(
+        [](const ExportJob& job, int written, int total, double elapsed) {
+            double progress = 100.0 * written / total;
+            double fps_actual = written / std::max(0.001, elapsed);
+            double eta = (total - written) / std::max(0.001, fps_actual);
 
-            int w, h, channels;
-            unsigned char* data = stbi_load(g_images.allFilePaths[idx].c_str(), &w, &h, &channels, 3);
-            if (data) {
-                // BUG FIX: Pass displayed image dimensions for proper view scaling
-                RenderViewToBufferHQ(buffer, winW, winH,
-                                     data, w, h,
-                                     capturedView, capturedSettings,
-                                     displayedW, displayedH);
-                stbi_image_free(data);
+            // Formatted locally: std::cout is shared with the display thread
+            std::ostringstream line;
+            line << "\rFrame " << written << "/" << total
+                 << " (" << std::fixed << std::setprecision(1) << progress << "%)"
+                 << " - " << fps_actual << " fps"
+                 << " - ETA: " << (int)(eta / 60) << "m " << (int)eta % 60 << "s";
+            std::cout << line.str() << std::flush;
+        },
+        [](const ExportJob& job, bool success, bool cancelled, double totalTime) {
+            if (!success) {
+                g_exportFailures++;
             }
-
-            {
-                std::unique_lock<std::mutex> lock(queueMutex);
-                queueNotFull.wait(lock, [&]() {
-                    return renderedFrames.size() < maxQueueSize || g_interrupted.load();
-                });
-                if (g_interrupted.load()) {
-                    delete[] buffer;
-                    break;
-                }
-                renderedFrames[idx] = buffer;
+            std::cout << std::endl;
+            if (g_interrupted.load()) {
+                std::cout << "\nExport interrupted by user." << std::endl;
+            } else if (cancelled) {
+                std::cout << "\nExport cancelled: " << job.outputFile << std::endl;
+            } else if (success) {
+                std::cout << "\nExport complete in " << (int)(totalTime / 60) << "m "
+                          << (int)totalTime % 60 << "s: " << job.outputFile << std::endl;
+            } else {
+                std::cout << "\nExport failed: " << job.outputFile << std::endl;
             }
-            queueNotEmpty.notify_one();
-        }
-    };
-
-    std::vector<std::thread> workers;
-    workers.reserve(numExportThreads);
-    for (int i = 0; i < numExportThreads; ++i) {
-        workers.emplace_back(renderWorker);
-    }
-
-    auto start = std::chrono::high_resolution_clock::now();
-
-    while (nextFrameToWrite < totalFrames && !g_interrupted.load()) {
-        unsigned char* frameData = nullptr;
-
-        {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            queueNotEmpty.wait(lock, [&]() {
-                return renderedFrames.find(nextFrameToWrite) != renderedFrames.end()
-                       || g_interrupted.load();
-            });
-
-            if (g_interrupted.load()) break;
-
-            frameData = renderedFrames[nextFrameToWrite];
-            renderedFrames.erase(nextFrameToWrite);
-        }
-        queueNotFull.notify_one();
-
-        std::fwrite(frameData, 1, frameBufferSize, ffmpeg);
-        delete[] frameData;
-
-        ++nextFrameToWrite;
-
-        double progress = 100.0 * nextFrameToWrite / totalFrames;
-        auto now = std::chrono::high_resolution_clock::now();
-        double elapsed = std::chrono::duration<double>(now - start).count();
-        double fps_actual = nextFrameToWrite / std::max(0.001, elapsed);
-        double eta = (totalFrames - nextFrameToWrite) / std::max(0.001, fps_actual);
-
-        if (g_window) {
-            char title[256];
-            std::snprintf(title, sizeof(title),
-                          "Exporting MT: %zu/%zu (%.1f%%)",
-                          nextFrameToWrite, totalFrames, progress);
-            SDL_SetWindowTitle(g_window, title);
-        }
+        });
+}
 
-        std::cout << "\rFrame " << nextFrameToWrite << "/" << totalFrames
-                  << " (" << std::fixed << std::setprecision(1) << progress << "%)"
-                  << " - " << fps_actual << " fps"
-                  << " - ETA: " << (int)(eta / 60) << "m " << (int)eta % 60 << "s" << std::flush;
+// --batch-export: load, export the starting view (window size, levels and colormap
+// from the command line) and exit, without SDL. For batch jobs: SIGTERM at the time
+// limit stops at the last checkpoint, and the same command line with --export-resume
+// continues from it. Returns the process exit status.
+int RunBatchExport() {
+    bool loaded = g_settings.mode3D ? LoadImagesFrom3DFolder(g_settings.initialFolder)
+                                    : LoadImagesFromFolder(g_settings.initialFolder);
+    if (!loaded) {
+        std::cerr << "Failed to load images from: " << g_settings.initialFolder << std::endl;
+        g_zLoader.stop();
+        return -1;
     }
-
-    for (auto& t : workers) {
-        if (t.joinable()) t.join();
+    if (g_settings.autoLevels) {
+        AutoLevels(true);
+    } else if (g_settings.levelsLow >= 0.0 && g_images.pixelFormat != PixelFormat::RGB8) {
+        SetLevels(g_settings.levelsLow, g_settings.levelsHigh);
     }
-
-    std::cout << std::endl;
-    pclose(ffmpeg);
-
-    auto end = std::chrono::high_resolution_clock::now();
-    double totalTime = std::chrono::duration<double>(end - start).count();
-
-    if (g_interrupted.load()) {
-        std::cout << "\nExport interrupted by user." << std::endl;
-    } else {
-        std::cout << "\nExport complete in " << (int)(totalTime / 60) << "m "
-                  << (int)totalTime % 60 << "s" << std::endl;
+    
+    InstallExportCallbacks();
+    QueueExport();
+    bool queued = g_exportQueue.busy();
+    while (g_exportQueue.busy()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
-
-    UpdateWindowTitle();
-    g_view.isPlaying = wasPlaying;
+    
+    g_exportQueue.shutdown();
+    g_watcher.stop();
+    g_zLoader.stop();
+    g_images.cleanup();
+    return (queued && g_exportFailures.load() == 0) ? 0 : 1;
 }
@@ -0,0 +1,192 @@
+// Folder watching implementation (inotify)
+
+#include "folder_watcher.h"
+#include "../common/image_loader.h"
+#include "../common/histogram.h"
+#include "../common/frame_store.h"
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+bool FolderWatcher::start(const FileTable& known, int shrinkFactor, int nthFrame, int width, int height,
+                          PixelFormat format, FrameCompression compression) {
+    stop();
+
+    m_folder = known.folder();
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+        std::cerr << "Could not initialize inotify: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if (inotify_add_watch(m_fd, m_folder.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        std::cerr << "Could not watch " << m_folder << ": " << strerror(errno) << std::endl;
+        close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_shrinkFactor = shrinkFactor;
+    m_nthFrame = std::max(1, nthFrame);
+    m_width = width;
+    m_height = height;
+    m_format = format;
+    m_compression = compression;
+    m_count = known.size();
+    m_unreadable.clear();
+    m_known.clear();
+    for (size_t i = 0; i < known.size(); ++i) {
+        m_known.insert(known.index(i));
+    }
+
+    m_stopping = false;
+    m_running = true;
+    m_thread = std::thread(&FolderWatcher::run, this);
+    return true;
+}
+
+void FolderWatcher::stop() {
+    m_stopping = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& frame : m_frames) {
+        FreeFrameBuffer(frame.data);
+    }
+    m_frames.clear();
+    m_names.clear();
+}
+
+bool FolderWatcher::takeNew(std::vector<std::string>& names, std::vector<ImageFrame>& frames) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_names.empty()) return false;
+    names.swap(m_names);
+    frames.swap(m_frames);
+    m_names.clear();
+    m_frames.clear();
+    return true;
+}
+
+void FolderWatcher::run() {
+    // Files finished between the folder scan and the watch have no event of their own
+    rescan();
+
+    // Unreadable files get no further event unless rewritten, so they are retried
+    const auto retryInterval = std::chrono::seconds(2);
+    auto lastRetry = std::chrono::steady_clock::now();
+
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    while (!m_stopping.load() && !g_interrupted.load()) {
+        if (!m_unreadable.empty() && std::chrono::steady_clock::now() - lastRetry >= retryInterval) {
+            retryUnreadable();
+            lastRetry = std::chrono::steady_clock::now();
+        }
+
+        struct pollfd pfd = {m_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+
+        ssize_t length = read(m_fd, buffer, sizeof(buffer));
+        for (ssize_t offset = 0; offset < length; ) {
+            const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were dropped: the folder listing is the only reliable source
+                rescan();
+            } else if (event->mask & IN_IGNORED) {
+                std::cerr << "Watched folder " << m_folder << " was removed" << std::endl;
+                m_running = false;
+                return;
+            } else if (event->len > 0) {
+                addFile(event->name, false);
+            }
+        }
+    }
+    m_running = false;
+}
+
+void FolderWatcher::retryUnreadable() {
+    // addFile drops a name from m_unreadable once it could be read
+    std::vector<std::string> names(m_unreadable.begin(), m_unreadable.end());
+    for (const std::string& name : names) {
+        addFile(name, false);
+    }
+}
+
+void FolderWatcher::rescan() {
+    DIR* dir = opendir(m_folder.c_str());
+    if (!dir) return;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr && !m_stopping.load()) {
+        if (entry->d_type == DT_REG || entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+            addFile(entry->d_name, true);
+        }
+    }
+    closedir(dir);
+}
+
+void FolderWatcher::addFile(const std::string& name, bool fromRescan) {
+    size_t length = name.size();
+    if (length <= 4 || name.compare(length - 4, 4, ".png") != 0) return;
+
+    int64_t index = ParseFrameIndex(name.data(), length);
+    if (index < 0 || m_known.count(index)) return;
+
+    ImageFrame frame;
+    if (m_count % m_nthFrame == 0) {
+        int w = 0, h = 0;
+        unsigned char* data = LoadAndShrinkImage(m_folder + "/" + name, m_shrinkFactor, w, h,
+                                                 true,   // rgbOutput
+                                                 false,  // flipVertical
+                                                 m_format);
+        if (!data) {
+            // A file found by the rescan may still be open for writing: its close event
+            // retries it. A closed one is not marked known but retried every few seconds.
+            if (!fromRescan && m_unreadable.insert(name).second) {
+                std::cerr << "Watch: cannot read " << name << " yet, retrying" << std::endl;
+            }
+            return;
+        }
+        if (w != m_width || h != m_height) {
+            std::cerr << "Watch: " << name << " has preview size " << w << " x " << h
+                      << " instead of " << m_width << " x " << m_height << ", skipping" << std::endl;
+            FreeFrameBuffer(data);
+            m_known.insert(index);
+            m_unreadable.erase(name);
+            return;
+        }
+        frame.filename = name;
+        frame.index = index;
+        frame.data = data;
+        frame.histogram = ComputeHistogram(data, (size_t)w * h, m_format);
+        
+        // Packed on its own: the loaded runs' keyframes are not at hand here
+        unsigned char* packed = PackFrame(m_compression, data, (size_t)w * h * BytesPerPixel(m_format),
+                                          nullptr, frame.packedBytes);
+        if (packed) {
+            FreeFrameBuffer(frame.data);
+            frame.data = packed;
+        }
+    }
+
+    m_known.insert(index);
+    m_unreadable.erase(name);
+    m_count++;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_names.push_back(name);
+    if (frame.data) {
+        m_frames.push_back(frame);
+    }
+}
@@ -0,0 +1,65 @@
+// Folder watching for PNG Image Viewer (Linux)
+// Follows a folder that is still being written, e.g. by a running simulation:
+// inotify reports *_<number>.png files once their writer closes them (or renames
+// them into place), and the new frames are decoded on the watcher thread
+
+#ifndef FOLDER_WATCHER_H
+#define FOLDER_WATCHER_H
+
+#include "../common/frame_types.h"
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+class FolderWatcher {
+public:
+    ~FolderWatcher() { stop(); }
+
+    // Watch known.folder(); files already in `known` are ignored. Every nthFrame-th
+    // new file (counting on from the known ones) is decoded at shrinkFactor to
+    // `format` and must have the preview size width x height; with `compression` it is
+    // packed on its own (no keyframe).
+    bool start(const FileTable& known, int shrinkFactor, int nthFrame, int width, int height,
+               PixelFormat format, FrameCompression compression = FrameCompression::Off);
+    void stop();
+    bool active() const { return m_running.load(); }
+    // Started, but the watch ended on its own (e.g. the folder was removed)
+    bool ended() const { return m_thread.joinable() && !m_running.load(); }
+
+    // Move the names of new files and the frames decoded since the last call into
+    // the caller's lists; returns false if nothing new has arrived
+    bool takeNew(std::vector<std::string>& names, std::vector<ImageFrame>& frames);
+
+private:
+    void run();
+    void rescan();
+    void addFile(const std::string& name, bool fromRescan);
+    void retryUnreadable();
+
+    std::string m_folder;
+    int m_fd = -1;
+    std::thread m_thread;
+    std::atomic<bool> m_stopping{false};
+    std::atomic<bool> m_running{false};         // Watcher thread still watching
+
+    // Watcher thread only
+    int m_shrinkFactor = 1;
+    int m_nthFrame = 1;
+    int m_width = 0;
+    int m_height = 0;
+    PixelFormat m_format = PixelFormat::RGB8;
+    FrameCompression m_compression = FrameCompression::Off;
+    size_t m_count = 0;                         // Files in the sequence (for the n-th selection)
+    std::unordered_set<int64_t> m_known;        // Indices already in the sequence
+    std::unordered_set<std::string> m_unreadable;   // Closed but not decodable yet, retried
+
+    std::mutex m_mutex;
+    std::vector<std::string> m_names;
+    std::vector<ImageFrame> m_frames;
+};
+
+#endif // FOLDER_WATCHER_H